@@ -0,0 +1,480 @@
+#include "apu.hpp"
+
+
+namespace {
+
+// NRx1 duty patterns, step 0 first (bit 7)
+constexpr uint8_t DUTY[4] = { 0b00000001, 0b10000001, 0b10000111, 0b01111110 };
+
+// Bits that read back as 1, 0xFF10-0xFF3F (write-only and unused bits)
+constexpr uint8_t READ_MASK[0x30] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,               // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,               // (unused), NR21-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,               // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,               // (unused), NR41-NR44
+    0x00, 0x00, 0x70,                           // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    // wave RAM reads back as written
+};
+
+// Register values after the boot ROM (DMG), 0xFF10-0xFF26
+constexpr uint8_t POWER_ON[0x17] = {
+    0x80, 0xBF, 0xF3, 0xFF, 0xBF,
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,
+    0x77, 0xF3, 0xF1,
+};
+
+constexpr uint8_t WAVE_POWER_ON[16] = {
+    0x84, 0x40, 0x43, 0xAA, 0x2D, 0x78, 0x92, 0x3C,
+    0x60, 0x59, 0x59, 0xB0, 0x34, 0xB8, 0x2E, 0xDA,
+};
+
+enum Reg : uint8_t {
+    NR10 = 0x00, NR11, NR12, NR13, NR14,
+    NR21 = 0x06, NR22, NR23, NR24,
+    NR30 = 0x0A, NR31, NR32, NR33, NR34,
+    NR41 = 0x10, NR42, NR43, NR44,
+    NR50 = 0x14, NR51, NR52,
+    WAVE = 0x20,
+};
+
+} // namespace
+
+
+void APU::Envelope::step()
+{
+    if (period == 0) return;
+    if (timer > 1) { --timer; return; }
+    timer = period;
+    if (up && volume < 15) ++volume;
+    else if (!up && volume > 0) --volume;
+}
+
+int APU::Square::level() const
+{
+    if (!enabled || !dac) return 0;
+    return ((DUTY[duty] >> (7 - dutyPos)) & 1) ? env.volume : 0;
+}
+
+int APU::Wave::level() const
+{
+    static constexpr uint8_t SHIFT[4] = { 4, 0, 1, 2 };   // mute, 100%, 50%, 25%
+    if (!enabled || !dac) return 0;
+    return sample >> SHIFT[volumeCode];
+}
+
+int APU::Noise::level() const
+{
+    if (!enabled || !dac) return 0;
+    return (lfsr & 1) ? 0 : env.volume;
+}
+
+
+APU::APU()
+{
+    reset();
+}
+
+void APU::reset()
+{
+    square1 = Square{};
+    square2 = Square{};
+    wave = Wave{};
+    noise = Noise{};
+    power = true;
+    sequencerStep = 0;
+    for (int i = 0; i < 0x17; ++i) {
+        regs[i] = POWER_ON[i];
+        applyRegister(i, POWER_ON[i]);
+    }
+    for (int i = 0; i < 16; ++i)
+        regs[WAVE + i] = WAVE_POWER_ON[i];
+
+    // The boot chime leaves channel 1 on, faded out
+    square1.enabled = true;
+    square1.env.volume = 0;
+    refreshAmps();
+}
+
+void APU::setOutput(Output sink, int sampleRate)
+{
+    output = std::move(sink);
+    const uint32_t maxClocks = 2 * BLOCK_CYCLES * CLOCKS_PER_CYCLE;   // blocks can end late
+    left.setRates(CLOCK_RATE, sampleRate, maxClocks);
+    right.setRates(CLOCK_RATE, sampleRate, maxClocks);
+    blockStart = clock;
+    mixLeft = mixRight = 0;
+    updateMix(clock);
+}
+
+uint8_t APU::read(uint16_t address, uint64_t now)
+{
+    const int index = address - 0xFF10;
+    if (index != NR52)
+        return regs[index] | READ_MASK[index];
+
+    // Length counters may have run out since the last access
+    catchUp(now * CLOCKS_PER_CYCLE);
+    return uint8_t((power ? 0x80 : 0) | READ_MASK[NR52]
+        | (square1.enabled ? 0x01 : 0) | (square2.enabled ? 0x02 : 0)
+        | (wave.enabled ? 0x04 : 0) | (noise.enabled ? 0x08 : 0));
+}
+
+void APU::write(uint16_t address, uint8_t value, uint64_t now)
+{
+    catchUp(now * CLOCKS_PER_CYCLE);
+    const int index = address - 0xFF10;
+
+    if (index >= WAVE) {
+        regs[index] = value;
+        return;
+    }
+    if (index == NR52) {
+        if (!(value & 0x80) && power) powerOff();
+        else if ((value & 0x80) && !power) { power = true; sequencerStep = 0; }
+        return;
+    }
+    if (!power) return;          // everything else is read-only while off
+
+    regs[index] = value;
+    applyRegister(index, value);
+    if (value & 0x80) {
+        switch (index) {
+        case NR14: trigger(0); break;
+        case NR24: trigger(1); break;
+        case NR34: trigger(2); break;
+        case NR44: trigger(3); break;
+        default: break;
+        }
+    }
+    refreshAmps();
+}
+
+void APU::applyRegister(int index, uint8_t value)
+{
+    Square& sq = index < NR21 ? square1 : square2;
+    switch (index) {
+    case NR10:
+        square1.sweepPeriod = (value >> 4) & 0x07;
+        square1.sweepDown = value & 0x08;
+        square1.sweepShift = value & 0x07;
+        break;
+    case NR11: case NR21:
+        sq.duty = value >> 6;
+        sq.length = 64 - (value & 0x3F);
+        break;
+    case NR12: case NR22:
+        sq.env.load(value);
+        sq.dac = value & 0xF8;
+        if (!sq.dac) sq.enabled = false;
+        break;
+    case NR13: case NR23:
+        sq.freq = uint16_t((sq.freq & 0x700) | value);
+        break;
+    case NR14: case NR24:
+        sq.freq = uint16_t((sq.freq & 0xFF) | ((value & 0x07) << 8));
+        sq.lengthOn = value & 0x40;
+        break;
+
+    case NR30:
+        wave.dac = value & 0x80;
+        if (!wave.dac) wave.enabled = false;
+        break;
+    case NR31: wave.length = 256 - value; break;
+    case NR32: wave.volumeCode = (value >> 5) & 0x03; break;
+    case NR33: wave.freq = uint16_t((wave.freq & 0x700) | value); break;
+    case NR34:
+        wave.freq = uint16_t((wave.freq & 0xFF) | ((value & 0x07) << 8));
+        wave.lengthOn = value & 0x40;
+        break;
+
+    case NR41: noise.length = 64 - (value & 0x3F); break;
+    case NR42:
+        noise.env.load(value);
+        noise.dac = value & 0xF8;
+        if (!noise.dac) noise.enabled = false;
+        break;
+    case NR43:
+        noise.shift = value >> 4;
+        noise.narrow = value & 0x08;
+        noise.divisor = value & 0x07;
+        break;
+    case NR44: noise.lengthOn = value & 0x40; break;
+    default: break;              // NR50/NR51 are only read by updateMix()
+    }
+}
+
+void APU::trigger(int ch)
+{
+    if (ch < 2) {
+        Square& sq = ch == 0 ? square1 : square2;
+        sq.enabled = sq.dac;
+        if (sq.length == 0) sq.length = 64;
+        sq.timer = sq.period();
+        sq.env.trigger();
+        if (ch == 0) {
+            sq.shadow = sq.freq;
+            sq.sweepTimer = sq.sweepPeriod ? sq.sweepPeriod : 8;
+            sq.sweepOn = sq.sweepPeriod || sq.sweepShift;
+            if (sq.sweepShift) sweepTarget();          // overflow check only
+        }
+    }
+    else if (ch == 2) {
+        wave.enabled = wave.dac;
+        if (wave.length == 0) wave.length = 256;
+        wave.timer = wave.period();
+        wave.pos = 0;
+    }
+    else {
+        noise.enabled = noise.dac;
+        if (noise.length == 0) noise.length = 64;
+        noise.timer = noise.period();
+        noise.env.trigger();
+        noise.lfsr = 0x7FFF;
+    }
+}
+
+void APU::powerOff()
+{
+    for (int i = 0; i < NR52; ++i) regs[i] = 0;
+    square1 = Square{};
+    square2 = Square{};
+    wave = Wave{};
+    noise = Noise{};
+    power = false;
+    refreshAmps();
+}
+
+void APU::resetDiv(uint64_t now)
+{
+    // The sequencer counts falling edges of DIV bit 4, so resetting DIV
+    // while the bit is set clocks it once more and restarts the period.
+    catchUp(now * CLOCKS_PER_CYCLE);
+    if ((clock - divBase) & (SEQUENCER_PERIOD / 2))
+        clockSequencer();
+    divBase = clock;
+    nextSequencer = clock + SEQUENCER_PERIOD;
+}
+
+void APU::endBlock(uint64_t now)
+{
+    catchUp(now * CLOCKS_PER_CYCLE);
+    if (output) {
+        const uint32_t clocks = uint32_t(clock - blockStart);
+        left.endFrame(clocks);
+        right.endFrame(clocks);
+        const int frames = left.samplesAvail();
+        samples.resize(size_t(frames) * 2);
+        left.readSamples(samples.data(), frames, 2);
+        right.readSamples(samples.data() + 1, frames, 2);
+        output(samples.data(), frames);
+    }
+    blockStart = clock;
+}
+
+void APU::catchUp(uint64_t target)
+{
+    if (target <= clock) return;
+    // Channels run freely between sequencer ticks, which are the only
+    // other thing that changes them
+    while (nextSequencer <= target) {
+        runChannels(clock, nextSequencer);
+        clock = nextSequencer;
+        clockSequencer();
+        nextSequencer += SEQUENCER_PERIOD;
+    }
+    runChannels(clock, target);
+    clock = target;
+}
+
+void APU::runChannels(uint64_t from, uint64_t to)
+{
+    if (!power) return;
+    runSquare(0, square1, from, to);
+    runSquare(1, square2, from, to);
+    runWave(from, to);
+    runNoise(from, to);
+}
+
+void APU::runSquare(int ch, Square& sq, uint64_t from, uint64_t to)
+{
+    if (!sq.enabled) return;
+    const int32_t period = sq.period();
+    uint64_t span = to - from;
+
+    if (!output || sq.env.volume == 0 || !sq.dac) {
+        // Nothing to hear: just move the duty position along
+        if (span < uint64_t(sq.timer)) { sq.timer -= int32_t(span); return; }
+        span -= uint64_t(sq.timer);
+        sq.dutyPos = uint8_t((sq.dutyPos + 1 + span / period) & 7);
+        sq.timer = int32_t(period - span % period);
+        amps[ch] = sq.level();
+        return;
+    }
+
+    uint64_t t = from;
+    while (uint64_t(sq.timer) <= to - t) {
+        t += uint64_t(sq.timer);
+        sq.timer = period;
+        sq.dutyPos = (sq.dutyPos + 1) & 7;
+        setAmp(ch, sq.level(), t);
+    }
+    sq.timer -= int32_t(to - t);
+}
+
+void APU::runWave(uint64_t from, uint64_t to)
+{
+    if (!wave.enabled) return;
+    const int32_t period = wave.period();
+    auto fetch = [&] {
+        const uint8_t byte = regs[WAVE + wave.pos / 2];
+        wave.sample = (wave.pos & 1) ? (byte & 0x0F) : (byte >> 4);
+    };
+    uint64_t span = to - from;
+
+    if (!output) {
+        if (span < uint64_t(wave.timer)) { wave.timer -= int32_t(span); return; }
+        span -= uint64_t(wave.timer);
+        wave.pos = uint8_t((wave.pos + 1 + span / period) & 31);
+        wave.timer = int32_t(period - span % period);
+        fetch();
+        amps[2] = wave.level();
+        return;
+    }
+
+    uint64_t t = from;
+    while (uint64_t(wave.timer) <= to - t) {
+        t += uint64_t(wave.timer);
+        wave.timer = period;
+        wave.pos = (wave.pos + 1) & 31;
+        fetch();
+        setAmp(2, wave.level(), t);
+    }
+    wave.timer -= int32_t(to - t);
+}
+
+void APU::runNoise(uint64_t from, uint64_t to)
+{
+    if (!noise.enabled) return;
+    const int32_t period = noise.period();
+    auto shift = [&] {
+        const uint16_t bit = (noise.lfsr ^ (noise.lfsr >> 1)) & 1;
+        noise.lfsr = uint16_t((noise.lfsr >> 1) | (bit << 14));
+        if (noise.narrow)
+            noise.lfsr = uint16_t((noise.lfsr & ~0x40) | (bit << 6));
+    };
+    uint64_t span = to - from;
+
+    if (!output || noise.env.volume == 0 || !noise.dac) {
+        // Nothing to hear: the LFSR still has to move on, but only as bits
+        if (span < uint64_t(noise.timer)) { noise.timer -= int32_t(span); return; }
+        span -= uint64_t(noise.timer);
+        for (uint64_t n = 1 + span / period; n > 0; --n)
+            shift();
+        noise.timer = int32_t(period - span % period);
+        amps[3] = noise.level();
+        return;
+    }
+
+    uint64_t t = from;
+    while (uint64_t(noise.timer) <= to - t) {
+        t += uint64_t(noise.timer);
+        noise.timer = period;
+        shift();
+        setAmp(3, noise.level(), t);
+    }
+    noise.timer -= int32_t(to - t);
+}
+
+void APU::clockSequencer()
+{
+    const uint8_t step = sequencerStep;
+    sequencerStep = (sequencerStep + 1) & 7;
+    if (!power) return;
+
+    if ((step & 1) == 0) clockLength();
+    if (step == 2 || step == 6) clockSweep();
+    if (step == 7) {
+        square1.env.step();
+        square2.env.step();
+        noise.env.step();
+    }
+    refreshAmps();
+}
+
+void APU::clockLength()
+{
+    auto tick = [](bool lengthOn, int& length, bool& enabled) {
+        if (lengthOn && length > 0 && --length == 0) enabled = false;
+    };
+    tick(square1.lengthOn, square1.length, square1.enabled);
+    tick(square2.lengthOn, square2.length, square2.enabled);
+    tick(wave.lengthOn, wave.length, wave.enabled);
+    tick(noise.lengthOn, noise.length, noise.enabled);
+}
+
+void APU::clockSweep()
+{
+    Square& sq = square1;
+    if (sq.sweepTimer > 1) { --sq.sweepTimer; return; }
+    sq.sweepTimer = sq.sweepPeriod ? sq.sweepPeriod : 8;
+    if (!sq.sweepOn || sq.sweepPeriod == 0) return;
+
+    const uint16_t target = sweepTarget();
+    if (target <= 2047 && sq.sweepShift) {
+        sq.shadow = target;
+        sq.freq = target;
+        regs[NR13] = uint8_t(target);
+        regs[NR14] = uint8_t((regs[NR14] & ~0x07) | (target >> 8));
+        sweepTarget();                                // checked again, not applied
+    }
+}
+
+uint16_t APU::sweepTarget()
+{
+    Square& sq = square1;
+    const uint16_t delta = sq.shadow >> sq.sweepShift;
+    const uint16_t target = sq.sweepDown ? uint16_t(sq.shadow - delta) : uint16_t(sq.shadow + delta);
+    if (target > 2047) sq.enabled = false;
+    return target;
+}
+
+void APU::setAmp(int ch, int amp, uint64_t t)
+{
+    if (amps[ch] == amp) return;
+    amps[ch] = amp;
+    updateMix(t);
+}
+
+void APU::refreshAmps()
+{
+    amps[0] = square1.level();
+    amps[1] = square2.level();
+    amps[2] = wave.level();
+    amps[3] = noise.level();
+    updateMix(clock);
+}
+
+void APU::updateMix(uint64_t t)
+{
+    // NR51: bits 4-7 send channels 1-4 left, bits 0-3 right. NR50 sets
+    // each side's volume, 1-8.
+    const uint8_t pan = regs[NR51];
+    int l = 0, r = 0;
+    for (int ch = 0; ch < 4; ++ch) {
+        if (pan & (0x10 << ch)) l += amps[ch];
+        if (pan & (0x01 << ch)) r += amps[ch];
+    }
+    l *= ((regs[NR50] >> 4) & 0x07) + 1;
+    r *= (regs[NR50] & 0x07) + 1;
+
+    if (output) {
+        const uint32_t time = uint32_t(t - blockStart);
+        if (l != mixLeft) left.addDelta(time, (l - mixLeft) * AMP_SCALE);
+        if (r != mixRight) right.addDelta(time, (r - mixRight) * AMP_SCALE);
+    }
+    mixLeft = l;
+    mixRight = r;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "blipbuf.hpp"
+
+// DMG audio: two square channels (the first with a frequency sweep), the
+// wave channel and the noise LFSR, clocked by the DIV-driven frame
+// sequencer. Nothing runs per cycle. The APU catches up to the scheduler
+// clock when one of its registers is accessed or a sample block is due,
+// and writes each amplitude change straight into band-limited buffers at
+// the output rate.
+//
+// APU clocks are dots (two per scheduler cycle, as for the PPU; see
+// GameBoy::step), so pitch and sample rate stay in step with the frames.
+class APU {
+public:
+    static constexpr uint32_t CLOCK_RATE = 4194304;       // APU clocks per second
+    static constexpr int CLOCKS_PER_CYCLE = 2;            // per scheduler cycle
+    static constexpr uint32_t BLOCK_CYCLES = 8192;        // scheduler cycles per sample block
+
+    APU();
+    void reset();                                         // power-on registers
+
+    // 0xFF10-0xFF3F, `now` being the scheduler clock
+    uint8_t read(uint16_t address, uint64_t now);
+    void write(uint16_t address, uint8_t value, uint64_t now);
+    void resetDiv(uint64_t now);                          // DIV was written
+    void endBlock(uint64_t now);                          // SchedEvent::AudioBlock
+
+    // Gets every finished block as interleaved stereo samples, on the
+    // emulation thread. Without one the channels still run (NR52 and the
+    // length counters stay right) but nothing is synthesized.
+    using Output = std::function<void(const int16_t* samples, int frames)>;
+    void setOutput(Output sink, int sampleRate = 48000);
+
+private:
+    static constexpr uint32_t SEQUENCER_PERIOD = 8192;    // 512 Hz, DIV bit 4
+    static constexpr int AMP_SCALE = 64;                  // mix (0-480) to sample units
+
+    struct Envelope {
+        uint8_t initial = 0, period = 0, timer = 0, volume = 0;
+        bool up = false;
+        void load(uint8_t nrx2) { initial = nrx2 >> 4; up = nrx2 & 0x08; period = nrx2 & 0x07; }
+        void trigger() { volume = initial; timer = period; }
+        void step();
+    };
+
+    struct Square {
+        bool enabled = false, dac = false, lengthOn = false;
+        uint8_t duty = 0, dutyPos = 0;
+        uint16_t freq = 0;
+        int32_t timer = 0;          // clocks to the next duty step
+        int length = 0;
+        Envelope env;
+        // Channel 1 only
+        uint8_t sweepPeriod = 0, sweepShift = 0, sweepTimer = 0;
+        bool sweepDown = false, sweepOn = false;
+        uint16_t shadow = 0;
+        int32_t period() const { return (2048 - freq) * 4; }
+        int level() const;
+    };
+
+    struct Wave {
+        bool enabled = false, dac = false, lengthOn = false;
+        uint8_t volumeCode = 0, pos = 0, sample = 0;
+        uint16_t freq = 0;
+        int32_t timer = 0;
+        int length = 0;
+        int32_t period() const { return (2048 - freq) * 2; }
+        int level() const;
+    };
+
+    struct Noise {
+        bool enabled = false, dac = false, lengthOn = false, narrow = false;
+        uint8_t shift = 0, divisor = 0;
+        uint16_t lfsr = 0x7FFF;
+        int32_t timer = 0;
+        int length = 0;
+        Envelope env;
+        int32_t period() const { return (divisor ? divisor * 16 : 8) << shift; }
+        int level() const;
+    };
+
+    Square square1, square2;
+    Wave wave;
+    Noise noise;
+    uint8_t regs[0x30] {};          // 0xFF10-0xFF3F as written (wave RAM at 0x20)
+    bool power = true;
+    uint8_t sequencerStep = 0;
+
+    uint64_t clock = 0;             // APU time caught up to
+    uint64_t nextSequencer = SEQUENCER_PERIOD;
+    uint64_t divBase = 0;           // clock of the last DIV reset
+    uint64_t blockStart = 0;        // clock the current sample block began at
+
+    Output output;
+    BlipBuffer left, right;
+    std::vector<int16_t> samples;
+    int amps[4] {};                 // channel outputs, 0-15
+    int mixLeft = 0, mixRight = 0;  // what the buffers were last told
+
+    void catchUp(uint64_t target);
+    void runChannels(uint64_t from, uint64_t to);
+    void runSquare(int ch, Square& sq, uint64_t from, uint64_t to);
+    void runWave(uint64_t from, uint64_t to);
+    void runNoise(uint64_t from, uint64_t to);
+    void clockSequencer();
+    void clockLength();
+    void clockSweep();
+    uint16_t sweepTarget();
+    void applyRegister(int index, uint8_t value);
+    void trigger(int ch);
+    void setAmp(int ch, int amp, uint64_t t);
+    void updateMix(uint64_t t);
+    void refreshAmps();
+    void powerOff();
+};
@@ -0,0 +1,59 @@
+#include "bgcache.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+
+BgMapCache::BgMapCache()
+{
+    for (auto& map : cells)
+        std::fill(std::begin(map), std::end(map), Cell{ 0, 0, 0, false });
+}
+
+const uint8_t* BgMapCache::row(const uint8_t* vram, const VRAMGenerations& gen,
+                               int map, uint8_t y, bool unsignedTiles,
+                               uint8_t x, int width)
+{
+    // LCDC bit 4 changed: every cell of this map points at other tiles now
+    if (builtUnsigned[map] != unsignedTiles) {
+        for (Cell& c : cells[map]) c.valid = false;
+        builtUnsigned[map] = unsignedTiles;
+    }
+
+    const int tileRow = y >> 3;
+    const int firstCol = x >> 3;
+    const int nCols = std::min(32, ((x & 0x07) + width + 7) >> 3);
+
+    for (int i = 0; i < nCols; ++i) {
+        int idx = tileRow * 32 + ((firstCol + i) & 31);
+        Cell& c = cells[map][idx];
+
+        uint8_t raw = vram[0x1800 + map * 0x400 + idx];
+        uint16_t tile = unsignedTiles ? raw : uint16_t(256 + int8_t(raw));
+
+        if (c.valid && c.mapGen == gen.mapCell[map][idx]
+            && c.tile == tile && c.tileGen == gen.tile[tile])
+            continue;
+
+        renderCell(vram, map, idx, tile);
+        c = { gen.mapCell[map][idx], gen.tile[tile], tile, true };
+    }
+    return bitmap[map][y];
+}
+
+void BgMapCache::renderCell(const uint8_t* vram, int map, int cell, uint16_t tile)
+{
+    const uint8_t* data = vram + tile * 16;
+    const int x0 = (cell & 31) * 8;
+    const int y0 = (cell >> 5) * 8;
+
+    for (int r = 0; r < 8; ++r) {
+        uint8_t lo = data[r * 2];
+        uint8_t hi = data[r * 2 + 1];
+        uint8_t* out = &bitmap[map][y0 + r][x0];
+        for (int px = 0; px < 8; ++px) {
+            int bit = 7 - px;
+            out[px] = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include "vramgen.hpp"
+
+// Pre-rendered 256x256 colour-index bitmaps of both tile maps (0x9800 and
+// 0x9C00) under the current LCDC tile-data mode. Each 8x8 cell remembers the
+// map-entry and tile generations it was drawn from and is redrawn only when
+// one of them moves, so a scrolling background costs a row copy per line.
+class BgMapCache {
+public:
+    BgMapCache();
+
+    // Row `y` of map `map` (0 = 0x9800, 1 = 0x9C00). Only the cells covering
+    // [x, x + width) (wrapping at 256) are guaranteed to be up to date.
+    const uint8_t* row(const uint8_t* vram, const VRAMGenerations& gen,
+                       int map, uint8_t y, bool unsignedTiles,
+                       uint8_t x, int width);
+
+private:
+    struct Cell {
+        uint32_t mapGen;
+        uint32_t tileGen;
+        uint16_t tile;      // tile number 0-383 the cell was drawn from
+        bool valid;
+    };
+
+    uint8_t bitmap[2][256][256];
+    Cell cells[2][1024];
+    bool builtUnsigned[2] = { true, true };   // tile-data mode per map
+
+    void renderCell(const uint8_t* vram, int map, int cell, uint16_t tile);
+};
@@ -0,0 +1,91 @@
+#include "blipbuf.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+const int16_t (&BlipBuffer::kernel())[PHASES][TAPS]
+{
+    // Low-pass step response differences for each sub-sample phase,
+    // Blackman-windowed, each phase normalised so a step of d adds up to
+    // exactly d once integrated.
+    static int16_t table[PHASES][TAPS];
+    static const bool built = [] {
+        const double pi = 3.14159265358979323846;
+        const double cutoff = 0.90;           // of Nyquist
+        for (int p = 0; p < PHASES; ++p) {
+            double taps[TAPS];
+            double sum = 0;
+            for (int i = 0; i < TAPS; ++i) {
+                const double x = i - (TAPS / 2 - 1) - double(p) / PHASES;
+                const double s = x == 0 ? cutoff : std::sin(pi * cutoff * x) / (pi * x);
+                const double w = (x + TAPS / 2) / TAPS;     // 0..1 across the kernel
+                const double blackman = 0.42 - 0.5 * std::cos(2 * pi * w) + 0.08 * std::cos(4 * pi * w);
+                taps[i] = s * blackman;
+                sum += taps[i];
+            }
+            int total = 0;
+            for (int i = 0; i < TAPS; ++i) {
+                table[p][i] = int16_t(std::lround(taps[i] / sum * (1 << UNIT_BITS)));
+                total += table[p][i];
+            }
+            table[p][TAPS / 2 - 1] += int16_t((1 << UNIT_BITS) - total);   // rounding error
+        }
+        return true;
+    }();
+    (void)built;
+    return table;
+}
+
+void BlipBuffer::setRates(double clockRate, double sampleRate, uint32_t maxClocks)
+{
+    factor = uint64_t(sampleRate / clockRate * 4294967296.0);
+    const size_t samples = size_t((uint64_t(maxClocks) * factor) >> 32) + 1;
+    buf.assign(samples + TAPS + 1, 0);
+    kernel();
+    clear();
+}
+
+void BlipBuffer::clear()
+{
+    std::fill(buf.begin(), buf.end(), 0);
+    offset = 0;
+    integrator = 0;
+}
+
+void BlipBuffer::addDelta(uint32_t time, int delta)
+{
+    const uint64_t pos = offset + time * factor;
+    const size_t index = size_t(pos >> 32);
+    if (index + TAPS > buf.size()) return;    // past the frame length promised
+    const int16_t* k = kernel()[(pos >> (32 - PHASE_BITS)) & (PHASES - 1)];
+    int32_t* out = &buf[index];
+    for (int i = 0; i < TAPS; ++i)
+        out[i] += k[i] * delta;
+}
+
+void BlipBuffer::endFrame(uint32_t clocks)
+{
+    offset += clocks * factor;
+}
+
+int BlipBuffer::readSamples(int16_t* out, int count, int stride)
+{
+    count = std::min(count, samplesAvail());
+    int32_t sum = integrator;
+    for (int i = 0; i < count; ++i) {
+        sum += buf[i];
+        const int32_t s = sum >> UNIT_BITS;
+        out[i * stride] = int16_t(std::clamp<int32_t>(s, INT16_MIN, INT16_MAX));
+        sum -= sum >> BASS_SHIFT;
+    }
+    integrator = sum;
+
+    // Keep the tails of steps that spill into samples not read yet
+    const size_t keep = buf.size() - size_t(count);
+    std::memmove(buf.data(), buf.data() + count, keep * sizeof(int32_t));
+    std::fill(buf.end() - count, buf.end(), 0);
+    offset -= uint64_t(count) << 32;
+    return count;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Band-limited synthesis buffer, after blargg's Blip_Buffer. The source
+// adds amplitude steps at clock times; each one is spread over a few
+// output samples by a windowed-sinc kernel, and reading integrates them.
+// A square wave then costs one addDelta() per edge instead of a sample per
+// source clock, and comes out at the output rate without aliasing.
+class BlipBuffer {
+public:
+    // maxClocks: the longest frame endFrame() will be given.
+    void setRates(double clockRate, double sampleRate, uint32_t maxClocks);
+    void clear();
+
+    void addDelta(uint32_t time, int delta);  // time: clocks since the frame began
+    void endFrame(uint32_t clocks);           // samples up to here become readable
+
+    int samplesAvail() const { return int(offset >> 32); }
+    // Read (and remove) up to count samples, every stride-th int16_t.
+    int readSamples(int16_t* out, int count, int stride);
+
+private:
+    static constexpr int PHASE_BITS = 5;
+    static constexpr int PHASES = 1 << PHASE_BITS;
+    static constexpr int TAPS = 16;
+    static constexpr int UNIT_BITS = 12;      // kernel phases sum to 1 << UNIT_BITS
+    static constexpr int BASS_SHIFT = 9;      // DC-blocking high-pass, ~15 Hz at 48 kHz
+
+    uint64_t factor = 0;      // output samples per clock, 32.32 fixed point
+    uint64_t offset = 0;      // frame start in samples from buf[0], 32.32
+    int32_t integrator = 0;
+    std::vector<int32_t> buf;
+
+    static const int16_t (&kernel())[PHASES][TAPS];
+};
@@ -1,5 +1,5 @@
 // Cartridge.cpp
-#include "Cartridge.hpp"
+#include "cartridge.hpp"
 #include <fstream>
 #include <iostream>
 #include <cassert>
@@ -72,6 +72,7 @@ void CPU::write8(uint16_t addr, uint8_t value) {
         // --- DIV reset ---
     case 0xFF04:
         timer.resetDIV();
+        memory->apu.resetDiv(memory->scheduler.now());   // frame sequencer
         return;
 
         // --- TIMA write ---
@@ -291,6 +292,15 @@ void CPU::handleInterrupts() {
 
 void CPU::cycle() {
     cycles = 0;
+
+    // STOP halts the clock until a selected P1 line is pulled low, whatever
+    // IE and IME say.
+    if (stopped) {
+        cycles += 1;
+        if ((read8(0xFF00) & 0x0F) == 0x0F)
+            return;
+        stopped = false;
+    }
     
     uint8_t triggered = read8(0xFFFF) & read8(0xFF0F) & 0x1F;
     bool fired = triggered != 0;
@@ -1346,8 +1356,9 @@ void CPU::executeInstruction() {
         enableInterruptsNext = true ;
 		break;
     case 0x10:
-		read8(pc++); // STOP instruction, ignored in this implementation
-        stopped = true;
+		read8(pc++); // STOP is two bytes
+        // With a button already held it does not stop at all
+        stopped = (read8(0xFF00) & 0x0F) == 0x0F;
         break;
         // --- RETI ---
     case 0xD9: {
@@ -87,6 +87,7 @@ public:
 	void reset();
 	void connectMemory(Memory* m);
 	bool isStopped() const { return stopped; }
+	bool isHalted() const { return halted; }
 	uint16_t getSP() const { return sp; }
 	uint16_t getPC() const { return pc; }
 	uint8_t getflags() const { return regs.f; } // Get the flags register
@@ -2,23 +2,30 @@
 
 #include "memory.hpp"
 
+#include <algorithm>
 
 
 
 void DMA::start(uint8_t highByte, Memory* mem) {
+    // Sources from 0xE000 up read the WRAM mirror, 0xFE/0xFF included
     source = highByte << 8;
-    progress = 0;
-    active = true;
+    if (source >= 0xE000) source -= 0x2000;
     memory = mem;
+    startTime = memory->scheduler.now();
+    active = true;
+    memory->scheduler.schedule(SchedEvent::DmaDone, LENGTH);   // a restart replaces it
 }
 
-// call once per *machine* cycle
-void DMA::tick() {
-    if (!active) return;
-    if (progress < 160) {
-        uint8_t data = memory->read(source + progress);
-        memory->oamPtr()[progress] = data;
-        ++progress;
-    }
-    if (progress == 160) active = false;
-}
\ No newline at end of file
+void DMA::complete() {
+    memory->copyDmaSource(source, memory->oamPtr(), LENGTH);
+    active = false;
+    memory->oamCache.reload(memory->oamPtr());
+}
+
+uint8_t DMA::busByte() const {
+    uint64_t elapsed = memory->scheduler.now() - startTime;
+    uint16_t offset = uint16_t(std::min<uint64_t>(elapsed, LENGTH - 1));
+    uint8_t value;
+    memory->copyDmaSource(uint16_t(source + offset), &value, 1);
+    return value;
+}
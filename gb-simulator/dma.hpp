@@ -3,15 +3,32 @@
 
 class Memory;
 
+// OAM DMA as a scheduled event: start() books the completion 160 M-cycles
+// ahead and complete() copies all 160 bytes at once. While it runs, OAM
+// reads as 0xFF and CPU accesses to the bus the DMA is reading from see the
+// byte being transferred (writes are dropped), so nothing can tell the copy
+// did not happen one byte per cycle.
 class DMA {
 public:
+	static constexpr int LENGTH = 160;     // bytes = M-cycles
+
 	void start(uint8_t highByte, Memory* mem);
-	void tick();
+	void complete();
 	bool isActive() const { return active; }
 
+	// CPU access to `address` collides with the transfer (same bus)
+	bool conflicts(uint16_t address) const
+	{
+		const bool dmaOnVram = source >= 0x8000 && source < 0xA000;
+		const bool onVram = address >= 0x8000 && address < 0xA000;
+		const bool external = address < 0x8000 || (address >= 0xA000 && address < 0xFE00);
+		return dmaOnVram ? onVram : external;
+	}
+	uint8_t busByte() const;               // what a conflicting read returns
+
 private:
 	Memory* memory = nullptr;
 	uint16_t source = 0;
-	uint16_t progress = 0;      // bytes copied so far (0-159)
+	uint64_t startTime = 0;                // scheduler time at start()
 	bool active = false;
 };
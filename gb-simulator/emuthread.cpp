@@ -0,0 +1,115 @@
+#include "emuthread.hpp"
+
+#include <algorithm>
+
+
+namespace {
+
+// Input is collected at fixed emulated-cycle positions: every frame, or
+// every pollMs of emulated time, and stamped into the following interval.
+// Frames stop with the LCD off, so a frame's worth of cycles is the longest
+// we go without looking.
+constexpr uint32_t FRAME_CYCLES = GameBoy::DOTS_PER_FRAME / 2;   // step() runs 2 dots per M-cycle
+
+uint32_t pollInterval(int pollMs)
+{
+    if (pollMs <= 0) return FRAME_CYCLES;
+    return std::min<uint32_t>(FRAME_CYCLES, uint32_t(pollMs) * 1048576u / 1000u);
+}
+
+} // namespace
+
+
+EmulationThread::EmulationThread(GameBoy& gb, int pollMs, FramePacer* pacer)
+    : gb(gb), pacer(pacer), pollCycles(pollInterval(pollMs)), pollEveryFrame(pollMs <= 0)
+{
+}
+
+void EmulationThread::start()
+{
+    if (thread.joinable()) return;
+    stopRequested = false;
+    thread = std::thread([this] { run(); });
+}
+
+void EmulationThread::stop()
+{
+    if (!thread.joinable()) return;
+    stopRequested = true;
+    wake();
+    thread.join();
+}
+
+void EmulationThread::postInput(HostInputQueue& queue)
+{
+    size_t sent = 0;
+    for (const HostInputEvent& ev : queue.pending()) {
+        if (!inputRing.push(ev)) break;
+        ++sent;
+    }
+    queue.consume(sent);
+    if (sent) wake();
+}
+
+void EmulationThread::wake()
+{
+    // Taking the lock orders this after park()'s check of the ring, so the
+    // notification cannot slip in between the check and the wait.
+    { std::lock_guard<std::mutex> lock(parkMutex); }
+    parkWake.notify_one();
+}
+
+void EmulationThread::park()
+{
+    std::unique_lock<std::mutex> lock(parkMutex);
+    parkWake.wait(lock, [this] {
+        return !inputRing.empty() || stopRequested.load(std::memory_order_relaxed);
+    });
+}
+
+void EmulationThread::applyInput()
+{
+    HostInputEvent ev;
+    while (inputRing.pop(ev))
+        pendingInput.push(ev.timeMs, ev.button, ev.pressed);
+    pendingInput.stampInto(gb.mem, gb.mem.scheduler.now(), pollCycles);
+}
+
+void EmulationThread::run()
+{
+    uint32_t cyclesSincePoll = 0;
+    uint32_t cyclesSinceFrame = 0;
+    for (;;) {
+        const int cycles = gb.step();
+        cyclesSincePoll += cycles;
+        cyclesSinceFrame += cycles;
+        const bool frameDone = gb.ppu.takeFrameReady();   // the SDL thread acquire()s it
+
+        // Pace on published frames. With the LCD off (or frames skipped)
+        // pace every frame's worth of cycles instead; the slack keeps that
+        // from firing just ahead of a real frame.
+        if (frameDone) {
+            cyclesSinceFrame = 0;
+            if (pacer) pacer->frameDone();
+        }
+        else if (cyclesSinceFrame >= FRAME_CYCLES + FRAME_CYCLES / 8) {
+            cyclesSinceFrame -= FRAME_CYCLES;
+            if (pacer) pacer->frameDone();
+        }
+
+        if ((frameDone && pollEveryFrame) || cyclesSincePoll >= pollCycles) {
+            cyclesSincePoll = 0;
+            if (stopRequested.load(std::memory_order_relaxed)) break;
+            applyInput();
+
+            // Nothing to emulate until a key goes down: sleep instead of
+            // spinning through idle frames. The pacer starts over on its
+            // own after the gap.
+            if (pacer && gb.idle()) {
+                park();
+                if (stopRequested.load(std::memory_order_relaxed)) break;
+                applyInput();
+            }
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "gameboy.hpp"
+#include "input.hpp"
+#include "pacer.hpp"
+#include "spsc.hpp"
+
+// Runs a GameBoy on its own thread so that presenting, vsync and compositor
+// stalls on the SDL thread never hold up emulation. The two sides only
+// share lock-free structures: host input goes in through an SPSC ring, and
+// frames come out through the PPU's FrameMailbox.
+//
+// With a pacer, a game that is fully idle (GameBoy::idle(), e.g. in STOP
+// waiting for a key) parks the thread until the SDL thread posts input.
+//
+// Ordering: create Video (SDL_Init) first, then start() this; stop() (or
+// the destructor) joins the thread before Video's destructor calls SDL_Quit.
+class EmulationThread {
+public:
+    // pollMs: how often host input is collected, in emulated ms (0 = once
+    // per frame). See HostInputQueue. Without a pacer the thread runs flat out.
+    EmulationThread(GameBoy& gb, int pollMs = 0, FramePacer* pacer = nullptr);
+    ~EmulationThread() { stop(); }
+
+    EmulationThread(const EmulationThread&) = delete;
+    EmulationThread& operator=(const EmulationThread&) = delete;
+
+    void start();
+    void stop();
+    bool running() const { return thread.joinable(); }
+
+    // SDL thread: hand queued host events over. Whatever does not fit in
+    // the ring stays in `queue` for the next call.
+    void postInput(HostInputQueue& queue);
+
+private:
+    GameBoy& gb;
+    FramePacer* pacer;
+    const uint32_t pollCycles;
+    const bool pollEveryFrame;
+    std::thread thread;
+    std::atomic<bool> stopRequested { false };
+    SpscRing<HostInputEvent, 1024> inputRing;
+    HostInputQueue pendingInput;    // emulation thread side
+    std::mutex parkMutex;
+    std::condition_variable parkWake;
+
+    void run();
+    void applyInput();
+    void park();
+    void wake();
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include "hash.hpp"
+
+// One finished LCD frame: a shade (0 = lightest, 3 = darkest) per pixel.
+struct Frame {
+    uint8_t pixels[144][160] {};
+    uint64_t number = 0;        // 1-based count of published frames
+
+    // Signature of the inputs each row was drawn from (0 = not signed), and
+    // which rows differ from the previously published frame. Consumers that
+    // saw frame number - 1 can upload/encode just the changed rows, or skip
+    // the frame entirely when `identical` is set.
+    uint64_t lineSig[144] {};
+    std::bitset<144> changedLines;
+    bool identical = false;
+};
+
+// 64-bit hash of a frame's pixels (shades only, not the bookkeeping), for
+// golden tests and divergence checks. Stable across platforms.
+inline uint64_t frameHash(const Frame& frame)
+{
+    return hash64(frame.pixels, sizeof(frame.pixels));
+}
+
+// Order-sensitive hash over a run of frame hashes: equal values mean every
+// frame of the run matched. sequenceHash() hashes any [first, first + count)
+// range of recorded hashes, so a mismatch can be bisected without rerunning.
+struct FrameSequenceHash {
+    uint64_t value = 0;
+    uint64_t frames = 0;
+    void add(uint64_t hash) { value = hashCombine(value, hash); ++frames; }
+};
+
+inline uint64_t sequenceHash(const std::vector<uint64_t>& hashes, size_t first, size_t count)
+{
+    FrameSequenceHash seq;
+    for (size_t i = first; i < first + count && i < hashes.size(); ++i)
+        seq.add(hashes[i]);
+    return seq.value;
+}
+
+// Lock-free triple buffer between one producer (the PPU) and one consumer
+// (SDL presenter, video encoder, hash checker...). The producer always owns
+// a back buffer and the consumer a front buffer; the third one sits in the
+// shared middle slot. Publishing and acquiring each swap an index with the
+// middle slot, so neither side blocks or copies, and the consumer only ever
+// sees complete frames - the newest one when it falls behind.
+class FrameMailbox {
+public:
+    // Producer side
+    Frame& back() { return buffers[backIndex]; }
+    void publish()
+    {
+        buffers[backIndex].number = ++published;
+        buffers[backIndex].identical = buffers[backIndex].changedLines.none();
+        uint8_t old = middle.exchange(uint8_t(backIndex | FRESH), std::memory_order_acq_rel);
+        backIndex = old & INDEX;
+    }
+
+    // Consumer side: newest complete frame, or nullptr if nothing new was
+    // published since the last call. The frame stays valid until the next
+    // successful acquire().
+    const Frame* acquire()
+    {
+        if (!(middle.load(std::memory_order_acquire) & FRESH))
+            return nullptr;
+        uint8_t old = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = old & INDEX;
+        return &buffers[frontIndex];
+    }
+    const Frame& front() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr uint8_t INDEX = 0x03;
+    static constexpr uint8_t FRESH = 0x04;    // middle holds an unread frame
+
+    Frame buffers[3];
+    uint8_t backIndex = 0;                    // producer-owned
+    uint8_t frontIndex = 1;                   // consumer-owned
+    std::atomic<uint8_t> middle { 2 };
+    uint64_t published = 0;                   // producer-owned
+};
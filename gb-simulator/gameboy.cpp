@@ -0,0 +1,52 @@
+#include "gameboy.hpp"
+
+
+GameBoy::GameBoy() : cpu(mem.io_registers)
+{
+    ppu.connectMemory(&mem);
+    ppu.connectVRAM(mem.vramPtr());
+    cpu.connectMemory(&mem);
+}
+
+int GameBoy::step()
+{
+    const bool clockStopped = cpu.isStopped();
+    cpu.cycle();
+    const int cycles = cpu.getCycles();
+    if (clockStopped) {
+        // The timers stop, but a linked peer may still clock bytes in
+        mem.serial.pollStopped();
+        if (mem.input.hasQueued()) mem.input.applyNextQueued();
+        return cycles;
+    }
+    mem.tick(cycles);
+    ppu.step(cycles * 2);
+    return cycles;
+}
+
+bool GameBoy::idle() const
+{
+    if (mem.input.hasQueued()) return false;
+    if (cpu.isStopped()) return (mem.read(0xFF00) & 0x0F) == 0x0F && !mem.serial.connected();
+    if (!cpu.isHalted()) return false;
+
+    const uint8_t enabled = mem.read(0xFFFF) & 0x1F;
+    const bool lcdOff = !(mem.io_registers[0x40] & 0x80);
+    return lcdOff
+        && (enabled & ~Memory::INT_JOYPAD) == 0
+        && (enabled & mem.io_registers[0x0F]) == 0
+        && !mem.scheduler.pending(SchedEvent::DmaDone)
+        && !mem.scheduler.pending(SchedEvent::SerialDone)
+        && !mem.serial.connected();
+}
+
+bool GameBoy::runFrame()
+{
+    // step() feeds the PPU two dots per M-cycle
+    int dots = 0;
+    while (dots < 2 * DOTS_PER_FRAME) {
+        dots += step() * 2;
+        if (ppu.takeFrameReady()) return true;
+    }
+    return false;
+}
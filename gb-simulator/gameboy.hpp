@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "ppu.hpp"
+
+// The emulated machine without any host frontend: memory, CPU and PPU wired
+// together the way main() used to do by hand. Frontends, the golden-test
+// tool and headless runs all drive one of these.
+class GameBoy {
+public:
+    GameBoy();
+
+    GameBoy(const GameBoy&) = delete;
+    GameBoy& operator=(const GameBoy&) = delete;
+
+    bool loadROM(const std::string& path) { return mem.loadROM(path); }
+
+    // One CPU instruction, then the scheduler (DMA, ...) and PPU catch up by
+    // the time it took. Returns the M-cycles executed. In STOP the system
+    // clock is off, so only the CPU (watching P1) steps, a linked peer's
+    // bytes are answered at once, and queued input is applied one event per
+    // step since no stamp can come due.
+    int step();
+
+    // Nothing can happen until a button is pressed: no link cable is plugged
+    // in, no queued input is in flight, and the CPU is in STOP or halted with
+    // the LCD off, only the joypad interrupt enabled and no transfer pending. A frontend may sleep the host
+    // thread meanwhile.
+    bool idle() const;
+
+    // Run until the PPU publishes a frame. With the LCD off (no frames) it
+    // gives up after two frames' worth of time. True if a frame was published.
+    bool runFrame();
+
+    Memory mem;
+    CPU cpu;
+    PPU ppu;
+
+    static constexpr int DOTS_PER_FRAME = 70224;
+};
@@ -1,57 +1,126 @@
 // gb-simulator.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
-#include "cpu.hpp"
-#include "ppu.hpp"
+#include "emuthread.hpp"
+#include "gameboy.hpp"
+#include "golden.hpp"
 #include "video.hpp"
 
 
 #include <iostream>
 #include <bitset>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <SDL.h>
 #define SDL_MAIN_HANDLE
 int main(int argc, char** argv)
 {
-	Memory mem;
+	if (argc > 1 && std::strcmp(argv[1], "--golden") == 0)
+		return goldenMain(argc, argv);
 
-	if (!mem.loadROM("lz.gb")) {
+	// gb-simulator [--poll-ms N] [--pace free|vsync|2x|4x|unlimited]
+	//              [--render inline|parallel|threaded] [--serial-out file|-] [rom]
+	const char* romPath = "lz.gb";
+	int pollMs = 0;                  // 0 = poll input once per frame
+	const char* serialPath = nullptr;  // - = stdout, as it is written
+	PacingMode pace = PacingMode::FreeRunning;
+	PPU::RenderMode render = PPU::RenderMode::Inline;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--poll-ms") == 0 && i + 1 < argc) {
+			pollMs = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--pace") == 0 && i + 1 < argc) {
+			const char* p = argv[++i];
+			pace = !std::strcmp(p, "vsync") ? PacingMode::VsyncLocked
+				: !std::strcmp(p, "2x") ? PacingMode::Speed2x
+				: !std::strcmp(p, "4x") ? PacingMode::Speed4x
+				: !std::strcmp(p, "unlimited") ? PacingMode::Unlimited
+				: PacingMode::FreeRunning;
+		}
+		else if (std::strcmp(argv[i], "--render") == 0 && i + 1 < argc) {
+			const char* r = argv[++i];
+			render = !std::strcmp(r, "parallel") ? PPU::RenderMode::Parallel
+				: !std::strcmp(r, "threaded") ? PPU::RenderMode::Threaded
+				: PPU::RenderMode::Inline;
+		}
+		else if (std::strcmp(argv[i], "--serial-out") == 0 && i + 1 < argc) {
+			serialPath = argv[++i];
+		}
+		else {
+			romPath = argv[i];
+		}
+	}
 
-		return 0;
+	// Declared before gb so it is still around while the GameBoy is torn down.
+	std::unique_ptr<SerialFileSink> serialFile;
+	if (serialPath) {
+		serialFile = std::strcmp(serialPath, "-") == 0
+			? std::make_unique<SerialFileSink>(stdout)
+			: std::make_unique<SerialFileSink>(std::string(serialPath));
+		if (!serialFile->isOpen()) {
+			std::cerr << "Cannot open " << serialPath << "\n";
+			return 1;
+		}
 	}
 
-	CPU cpu(mem.io_registers);
-	PPU ppu;
-	ppu.connectMemory(&mem);
-	ppu.connectVRAM(mem.vramPtr());
+	auto gb = std::make_unique<GameBoy>();
+	Memory& mem = gb->mem;
+	if (serialFile) mem.setSerialSink(serialFile.get());
+	PPU& ppu = gb->ppu;
 
-	cpu.connectMemory(&mem);
-	Video vid;
-	bool running = true;
+	if (!gb->loadROM(romPath)) {
 
+		return 0;
+	}
+	ppu.setRenderMode(render);
 
-	while (running)
 	{
-		////print flags for debugging:
-		////printf("F: 0x%02X \n", cpu.getflags());
-		////print registers for debugging:
-		//if ((cpu.getB() == 0x03 && cpu.getC() == 0x05) || (cpu.getB() == 0x42)) {
+		// This thread owns SDL (window, events, present); the CPU runs on the
+		// emulation thread. emu is declared after vid so it is joined before
+		// ~Video calls SDL_Quit.
+		FramePacer pacer(pace);
+		Video vid;
+		vid.attachPacer(&pacer);
+		if (vid.openAudio(48000)) {
+			gb->mem.apu.setOutput([&vid](const int16_t* samples, int frames) {
+				vid.queueAudio(samples, frames);
+			}, 48000);
+		}
+		EmulationThread emu(*gb, pollMs, &pacer);
+		emu.start();
 
-		//	//printf("A: 0x%02X B: 0x%02X C: 0x%02X D: 0x%02X E: 0x%02X H: 0x%02X L: 0x%02X\n", cpu.getA(), cpu.getB(), cpu.getC(), cpu.getD(), cpu.getE(), cpu.getH(), cpu.getL());
-		//}
+		bool running = true;
+		HostInputQueue hostInput;
+		uint32_t titleTime = SDL_GetTicks();
 
+		while (running)
+		{
+			running = vid.ProcessInput(hostInput);
+			emu.postInput(hostInput);
 
-		cpu.cycle();
-		//printf("Cycling");
-		for (uint16_t i = 0; i < cpu.getCycles(); ++i) mem.dma.tick();
-		ppu.step(cpu.getCycles() * 2);
-		running = vid.ProcessInput(mem.input);
-		if (ppu.takeFrameReady())
-			vid.present(ppu.framebuffer);
+			const Frame* frame = ppu.frameMailbox().acquire();
+			const bool presented = frame && vid.present(*frame);
+			if (pacer.mode() == PacingMode::VsyncLocked) {
+				if (!presented) vid.refresh();   // wait for the refresh anyway
+				pacer.vsyncTick();
+			}
+			else if (!frame) {
+				SDL_Delay(1);           // nothing new to show yet
+			}
 
+			if (SDL_GetTicks() - titleTime >= 500) {
+				titleTime = SDL_GetTicks();
+				vid.updateTitle();
+			}
+		}
+		emu.stop();
+		gb->mem.apu.setOutput(nullptr);
 	}
 	std::cout << "CPU halted. Test ROM finished.\n";
-	// Optionally dump serial output (0xFF01)
-	std::cout << "Serial output:\n";
-	for (char c : mem.serialBuffer) {
-		std::cout << c;
+	// Dump serial output (0xFF01) unless it was already streamed out
+	if (!serialFile) {
+		std::cout << "Serial output:\n";
+		std::cout << mem.serialLog.contents() << "\n";
 	}
 	
 	return 0;
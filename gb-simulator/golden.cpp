@@ -0,0 +1,213 @@
+#include "golden.hpp"
+#include "frame.hpp"
+#include "gameboy.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+
+namespace {
+
+bool parseButton(std::string name, GbButton& button)
+{
+    static const struct { const char* name; GbButton button; } names[] = {
+        { "up", GbButton::Up }, { "down", GbButton::Down },
+        { "left", GbButton::Left }, { "right", GbButton::Right },
+        { "a", GbButton::A }, { "b", GbButton::B },
+        { "select", GbButton::Select }, { "start", GbButton::Start },
+    };
+    std::transform(name.begin(), name.end(), name.begin(),
+        [](unsigned char c) { return char(std::tolower(c)); });
+    for (const auto& n : names) {
+        if (name == n.name) {
+            button = n.button;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+
+bool loadInputScript(const std::string& path, std::vector<ScriptedInput>& script, std::string& error)
+{
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open input script " + path;
+        return false;
+    }
+
+    script.clear();
+    std::string line;
+    for (int lineNo = 1; std::getline(in, line); ++lineNo) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        uint32_t frame;
+        std::string button, state;
+        if (!(fields >> frame)) continue;       // blank or comment-only line
+
+        ScriptedInput ev { frame, GbButton::A, false };
+        if (!(fields >> button >> state) || !parseButton(button, ev.button)
+            || (state != "down" && state != "up")) {
+            error = path + ":" + std::to_string(lineNo) + ": expected \"<frame> <button> down|up\"";
+            return false;
+        }
+        ev.pressed = (state == "down");
+        script.push_back(ev);
+    }
+
+    // Apply in frame order; events of the same frame keep their file order
+    std::stable_sort(script.begin(), script.end(),
+        [](const ScriptedInput& a, const ScriptedInput& b) { return a.frame < b.frame; });
+    return true;
+}
+
+size_t applyScript(const std::vector<ScriptedInput>& script, size_t next, uint32_t frame, Input& input)
+{
+    for (; next < script.size() && script[next].frame <= frame; ++next)
+        input.set_button(script[next].button, script[next].pressed);
+    return next;
+}
+
+bool runGolden(const std::string& rom, int frames, const std::vector<ScriptedInput>& script,
+               GoldenRun& run, std::string& error)
+{
+    auto gb = std::make_unique<GameBoy>();      // too big for the stack
+    if (!gb->loadROM(rom)) {
+        error = "cannot load ROM " + rom;
+        return false;
+    }
+
+    static const Frame blank {};
+    const Frame* shown = &blank;                // LCD off until the first frame
+    FrameSequenceHash sequence;
+    size_t next = 0;
+
+    run.frames.clear();
+    for (int f = 0; f < frames; ++f) {
+        next = applyScript(script, next, uint32_t(f), gb->mem.input);
+        gb->runFrame();
+        if (const Frame* frame = gb->ppu.frameMailbox().acquire())
+            shown = frame;
+
+        uint64_t h = frameHash(*shown);
+        run.frames.push_back(h);
+        sequence.add(h);
+    }
+    run.sequence = sequence.value;
+    return true;
+}
+
+bool saveGolden(const std::string& path, const GoldenRun& run)
+{
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "gbgolden 1 %zu %016" PRIx64 "\n", run.frames.size(), run.sequence);
+    for (size_t i = 0; i < run.frames.size(); ++i)
+        std::fprintf(f, "%zu %016" PRIx64 "\n", i, run.frames[i]);
+    return std::fclose(f) == 0;
+}
+
+bool loadGolden(const std::string& path, GoldenRun& run, std::string& error)
+{
+    std::ifstream in(path);
+    std::string magic;
+    int version = 0;
+    size_t count = 0;
+    if (!in || !(in >> magic >> version >> count >> std::hex >> run.sequence)
+        || magic != "gbgolden" || version != 1) {
+        error = path + ": not a golden file";
+        return false;
+    }
+
+    run.frames.assign(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        size_t index;
+        uint64_t hash;
+        if (!(in >> std::dec >> index >> std::hex >> hash) || index != i) {
+            error = path + ": bad entry for frame " + std::to_string(i);
+            return false;
+        }
+        run.frames[i] = hash;
+    }
+    return true;
+}
+
+int firstDivergence(const GoldenRun& expected, const GoldenRun& actual)
+{
+    if (expected.sequence == actual.sequence && expected.frames.size() == actual.frames.size())
+        return -1;
+    size_t n = std::min(expected.frames.size(), actual.frames.size());
+    for (size_t i = 0; i < n; ++i)
+        if (expected.frames[i] != actual.frames[i]) return int(i);
+    return expected.frames.size() == actual.frames.size() ? -1 : int(n);
+}
+
+int goldenMain(int argc, char** argv)
+{
+    auto usage = [] {
+        std::fprintf(stderr,
+            "usage: --golden record <rom> <golden file> <frames> [input script]\n"
+            "       --golden check  <rom> <golden file> [input script]\n");
+        return 2;
+    };
+    if (argc < 5) return usage();
+
+    const std::string mode = argv[2], rom = argv[3], goldenPath = argv[4];
+    const bool record = (mode == "record");
+    if (!record && mode != "check") return usage();
+    if (record && argc < 6) return usage();
+
+    std::string error;
+    std::vector<ScriptedInput> script;
+    const int scriptArg = record ? 6 : 5;
+    if (argc > scriptArg && !loadInputScript(argv[scriptArg], script, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    GoldenRun expected;
+    int frames = 0;
+    if (record) {
+        frames = std::atoi(argv[5]);
+        if (frames <= 0) return usage();
+    }
+    else {
+        if (!loadGolden(goldenPath, expected, error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        frames = int(expected.frames.size());
+    }
+
+    GoldenRun actual;
+    if (!runGolden(rom, frames, script, actual, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    if (record) {
+        if (!saveGolden(goldenPath, actual)) {
+            std::fprintf(stderr, "cannot write %s\n", goldenPath.c_str());
+            return 2;
+        }
+        std::printf("recorded %d frames, sequence %016" PRIx64 "\n", frames, actual.sequence);
+        return 0;
+    }
+
+    int diverged = firstDivergence(expected, actual);
+    if (diverged < 0) {
+        std::printf("ok: %d frames, sequence %016" PRIx64 "\n", frames, actual.sequence);
+        return 0;
+    }
+    std::printf("MISMATCH at frame %d: expected %016" PRIx64 ", got %016" PRIx64 "\n", diverged,
+        expected.frames[diverged], actual.frames[diverged]);
+    return 1;
+}
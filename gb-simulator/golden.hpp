@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "input.hpp"
+
+// -----------------------------------------------------------------------------
+//  Golden tests: run a ROM with scripted input for N frames, record the hash
+//  of every frame, and compare against a stored run. A mismatch names the
+//  first diverging frame, so there is nothing left to bisect.
+// -----------------------------------------------------------------------------
+
+// One scripted button change, applied just before frame `frame` runs.
+struct ScriptedInput {
+    uint32_t frame;
+    GbButton button;
+    bool pressed;
+};
+
+// Input script: one "<frame> <button> down|up" per line, '#' starts a
+// comment. Buttons: up down left right a b select start.
+bool loadInputScript(const std::string& path, std::vector<ScriptedInput>& script, std::string& error);
+
+// Apply the events due by `frame`, starting at script[next]; returns the
+// index of the first event still pending.
+size_t applyScript(const std::vector<ScriptedInput>& script, size_t next, uint32_t frame, Input& input);
+
+struct GoldenRun {
+    std::vector<uint64_t> frames;   // frameHash() of frame 0, 1, ...
+    uint64_t sequence = 0;          // FrameSequenceHash over all of them
+};
+
+bool runGolden(const std::string& rom, int frames, const std::vector<ScriptedInput>& script,
+               GoldenRun& run, std::string& error);
+
+// Text format: a "gbgolden 1 <frames> <sequence>" header, then one
+// "<frame> <hash>" line per frame, hashes in hex.
+bool saveGolden(const std::string& path, const GoldenRun& run);
+bool loadGolden(const std::string& path, GoldenRun& run, std::string& error);
+
+// First frame whose hash differs (or that only one run has), -1 if equal.
+int firstDivergence(const GoldenRun& expected, const GoldenRun& actual);
+
+// Command line:
+//   --golden record <rom> <golden file> <frames> [input script]
+//   --golden check  <rom> <golden file> [input script]
+// Returns the process exit code: 0 pass, 1 mismatch, 2 usage or I/O error.
+int goldenMain(int argc, char** argv);
@@ -0,0 +1,221 @@
+// headless.cpp : command-line runner for the core, with no SDL dependency.
+// Runs a ROM for a number of frames with optional scripted input and
+// reports frame hashes, speed and (optionally) the last frame as an image.
+//
+#include "frame.hpp"
+#include "gameboy.hpp"
+#include "golden.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+int usage()
+{
+    std::fprintf(stderr,
+        "usage: gb-headless <rom> [options]\n"
+        "  --frames N            frames to run (default 600)\n"
+        "  --input <script>      scripted input, see golden.hpp\n"
+        "  --hashes              print every frame's hash\n"
+        "  --dump <file.pgm>     write the last frame as a greyscale PGM\n"
+        "  --render inline|parallel|threaded\n"
+        "                        PPU render mode (default inline)\n"
+        "  --serial              print the serial output at the end\n"
+        "  --serial-out <file|->  stream the serial output as it is written\n"
+        "  --expect-serial <text>\n"
+        "                        exit 1 unless the serial output contains text;\n"
+        "                        stops as soon as it does\n"
+        "  --link <rom2>         run rom2 on a second thread, linked by cable\n"
+        "  --wav <file.wav>      record the audio (48 kHz stereo)\n"
+        "       gb-headless --golden record|check ...   (see golden.hpp)\n");
+    return 2;
+}
+
+bool writePGM(const std::string& path, const Frame& frame)
+{
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    std::fprintf(f, "P5\n160 144\n255\n");
+    uint8_t row[160];
+    for (const auto& line : frame.pixels) {
+        for (int x = 0; x < 160; ++x)
+            row[x] = uint8_t(255 - line[x] * 85);      // shade 0 = white
+        std::fwrite(row, 1, sizeof(row), f);
+    }
+    return std::fclose(f) == 0;
+}
+
+bool writeWAV(const std::string& path, const std::vector<int16_t>& samples, int rate)
+{
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    auto u32 = [f](uint32_t v) { uint8_t b[4] = { uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) }; std::fwrite(b, 1, 4, f); };
+    auto u16 = [f](uint16_t v) { uint8_t b[2] = { uint8_t(v), uint8_t(v >> 8) }; std::fwrite(b, 1, 2, f); };
+    const uint32_t bytes = uint32_t(samples.size() * 2);
+    std::fwrite("RIFF", 1, 4, f); u32(36 + bytes); std::fwrite("WAVE", 1, 4, f);
+    std::fwrite("fmt ", 1, 4, f); u32(16); u16(1); u16(2); u32(rate); u32(rate * 4); u16(4); u16(16);
+    std::fwrite("data", 1, 4, f); u32(bytes);
+    for (int16_t s : samples) u16(uint16_t(s));        // little-endian whatever the host
+    return std::fclose(f) == 0;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "--golden") == 0)
+        return goldenMain(argc, argv);
+
+    std::string romPath, scriptPath, dumpPath, serialPath, expectSerial, linkRomPath, wavPath;
+    int frames = 600;
+    bool printHashes = false;
+    bool printSerial = false;
+    PPU::RenderMode renderMode = PPU::RenderMode::Inline;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue)       frames = std::atoi(argv[++i]);
+        else if (arg == "--input" && hasValue)   scriptPath = argv[++i];
+        else if (arg == "--dump" && hasValue)    dumpPath = argv[++i];
+        else if (arg == "--hashes")              printHashes = true;
+        else if (arg == "--serial")              printSerial = true;
+        else if (arg == "--serial-out" && hasValue)    serialPath = argv[++i];
+        else if (arg == "--expect-serial" && hasValue) expectSerial = argv[++i];
+        else if (arg == "--link" && hasValue)    linkRomPath = argv[++i];
+        else if (arg == "--wav" && hasValue)     wavPath = argv[++i];
+        else if (arg == "--render" && hasValue) {
+            const std::string mode = argv[++i];
+            if (mode == "parallel")      renderMode = PPU::RenderMode::Parallel;
+            else if (mode == "threaded") renderMode = PPU::RenderMode::Threaded;
+            else if (mode != "inline")   return usage();
+        }
+        else if (arg[0] == '-' || !romPath.empty()) return usage();
+        else romPath = arg;
+    }
+    if (romPath.empty() || frames <= 0) return usage();
+
+    std::string error;
+    std::vector<ScriptedInput> script;
+    if (!scriptPath.empty() && !loadInputScript(scriptPath, script, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    std::unique_ptr<SerialFileSink> serialFile;
+    if (!serialPath.empty()) {
+        serialFile = serialPath == "-" ? std::make_unique<SerialFileSink>(stdout)
+                                       : std::make_unique<SerialFileSink>(serialPath);
+        if (!serialFile->isOpen()) {
+            std::fprintf(stderr, "cannot open %s\n", serialPath.c_str());
+            return 2;
+        }
+    }
+
+    auto gb = std::make_unique<GameBoy>();
+    if (serialFile) gb->mem.setSerialSink(serialFile.get());
+    if (!gb->loadROM(romPath)) {
+        std::fprintf(stderr, "cannot load ROM %s\n", romPath.c_str());
+        return 2;
+    }
+    gb->ppu.setRenderMode(renderMode);
+
+    constexpr int SAMPLE_RATE = 48000;
+    std::vector<int16_t> audio;
+    if (!wavPath.empty()) {
+        gb->mem.apu.setOutput([&audio](const int16_t* samples, int frames) {
+            audio.insert(audio.end(), samples, samples + 2 * frames);
+        }, SAMPLE_RATE);
+    }
+
+    // The linked instance runs freely on its own thread until the main one
+    // is done, which unplugs first so the peer never waits on it.
+    LinkCable cable;
+    std::unique_ptr<GameBoy> peer;
+    std::thread peerThread;
+    std::atomic<bool> peerStop { false };
+    if (!linkRomPath.empty()) {
+        peer = std::make_unique<GameBoy>();
+        if (!peer->loadROM(linkRomPath)) {
+            std::fprintf(stderr, "cannot load ROM %s\n", linkRomPath.c_str());
+            return 2;
+        }
+        gb->mem.connectLink(&cable.end(0));
+        peer->mem.connectLink(&cable.end(1));
+        peerThread = std::thread([&peer, &peerStop] {
+            while (!peerStop.load(std::memory_order_relaxed))
+                peer->runFrame();
+            peer->mem.connectLink(nullptr);
+        });
+    }
+
+    static const Frame blank {};
+    const Frame* shown = &blank;
+    FrameSequenceHash sequence;
+    size_t next = 0;
+
+    bool serialMatched = false;
+    int ran = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        next = applyScript(script, next, uint32_t(f), gb->mem.input);
+        gb->runFrame();
+        if (const Frame* frame = gb->ppu.frameMailbox().acquire())
+            shown = frame;
+
+        const uint64_t h = frameHash(*shown);
+        sequence.add(h);
+        if (printHashes)
+            std::printf("frame %d %016" PRIx64 "\n", f, h);
+        ++ran;
+
+        if (!expectSerial.empty() && gb->mem.serialLog.contains(expectSerial)) {
+            serialMatched = true;
+            break;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (peerThread.joinable()) {
+        gb->mem.connectLink(nullptr);
+        peerStop = true;
+        peerThread.join();
+    }
+
+    if (serialFile) serialFile->flush();
+
+    std::printf("frames   %d\n", ran);
+    std::printf("time     %.3f s (%.1f fps, %.2fx realtime)\n", seconds, ran / seconds,
+        ran / seconds / (4194304.0 / GameBoy::DOTS_PER_FRAME));
+    std::printf("last     %016" PRIx64 "\n", frameHash(*shown));
+    std::printf("sequence %016" PRIx64 "\n", sequence.value);
+
+    if (!dumpPath.empty() && !writePGM(dumpPath, *shown)) {
+        std::fprintf(stderr, "cannot write %s\n", dumpPath.c_str());
+        return 2;
+    }
+    if (!wavPath.empty() && !writeWAV(wavPath, audio, SAMPLE_RATE)) {
+        std::fprintf(stderr, "cannot write %s\n", wavPath.c_str());
+        return 2;
+    }
+    if (printSerial) {
+        std::printf("serial   %s\n", gb->mem.serialLog.contents().c_str());
+        if (peer)
+            std::printf("linked   %s\n", peer->mem.serialLog.contents().c_str());
+    }
+    if (!expectSerial.empty() && !serialMatched) {
+        std::fprintf(stderr, "serial output does not contain \"%s\"\n", expectSerial.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include "input.hpp"
 
+#include <algorithm>
+#include "memory.hpp"
+
 
 
 void Input::button_pressed(GbButton button) {
@@ -11,6 +14,7 @@ void Input::button_released(GbButton button) {
 }
 
 void Input::set_button(GbButton button, bool set) {
+    const uint8_t before = get_input();
     if (button == GbButton::Up) { up = set; }
     if (button == GbButton::Down) { down = set; }
     if (button == GbButton::Left) { left = set; }
@@ -19,11 +23,49 @@ void Input::set_button(GbButton button, bool set) {
     if (button == GbButton::B) { b = set; }
     if (button == GbButton::Select) { select = set; }
     if (button == GbButton::Start) { start = set; }
+    raiseOnFallingEdge(before);
+}
+
+void Input::raiseOnFallingEdge(uint8_t before) {
+    if (interruptFlag && (before & ~get_input() & 0x0F))
+        *interruptFlag |= 0x10;   // Memory::INT_JOYPAD
+}
+
+void Input::enqueue(const InputEvent& ev) {
+    auto at = std::upper_bound(queued.begin(), queued.end(), ev.cycle,
+        [](uint64_t cycle, const InputEvent& e) { return cycle < e.cycle; });
+    queued.insert(at, ev);
+}
+
+void Input::applyQueued(uint64_t now) {
+    while (!queued.empty() && queued.front().cycle <= now)
+        applyNextQueued();
+}
+
+void Input::applyNextQueued() {
+    const InputEvent ev = queued.front();
+    queued.pop_front();
+    set_button(ev.button, ev.pressed);
+}
+
+void HostInputQueue::stampInto(Memory& memory, uint64_t base, uint32_t span) {
+    if (events.empty()) return;
+    constexpr uint32_t CYCLES_PER_MS = 1048576u / 1000u;
+    const uint32_t first = events.front().timeMs;
+    for (const HostInputEvent& ev : events) {
+        // Host clocks do not go backwards, but a reordered ring might
+        const uint32_t ms = ev.timeMs > first ? ev.timeMs - first : 0;
+        const uint32_t offset = uint32_t(std::min<uint64_t>(uint64_t(ms) * CYCLES_PER_MS, span ? span - 1 : 0));
+        memory.queueInput(base + offset, ev.button, ev.pressed);
+    }
+    events.clear();
 }
 
 void Input::write(uint8_t set) {
+    const uint8_t before = get_input();
     direction_switch = (set & (1 << 4)) == 0;
     button_switch = (set & (1 << 5)) == 0;
+    raiseOnFallingEdge(before);
 }
 
 uint8_t Input::get_input() const {
@@ -1,8 +1,12 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <vector>
 
 #pragma once
 
+class Memory;
 
 enum class GbButton {
     Up,
@@ -15,6 +19,15 @@ enum class GbButton {
     Start,
 };
 
+// A button change stamped with the M-cycle (Scheduler::now()) at which the
+// core applies it. The same stamps give the same run, whatever the host
+// was doing, which is what replays and run-ahead rely on.
+struct InputEvent {
+    uint64_t cycle;
+    GbButton button;
+    bool pressed;
+};
+
 class Input {
 public:
     void button_pressed(GbButton button);
@@ -24,7 +37,23 @@ public:
     uint8_t get_input() const;
     void set_button(GbButton button, bool set);
 
+    // IF register to raise the joypad interrupt in when a selected P10-P13
+    // line goes from high to low, by a press or by a P1 select write.
+    void connectInterrupt(uint8_t* ifReg) { interruptFlag = ifReg; }
+
+    // Stamped events waiting for their cycle, in cycle order (equal stamps
+    // keep the order they were queued in). Memory::queueInput() queues and
+    // schedules them; nothing else should touch the buttons while they run.
+    void enqueue(const InputEvent& ev);
+    bool hasQueued() const { return !queued.empty(); }
+    uint64_t nextQueuedCycle() const { return queued.front().cycle; }
+    void applyQueued(uint64_t now);     // everything stamped at or before now
+    void applyNextQueued();             // the next one, whatever its stamp
+
 private:
+    std::deque<InputEvent> queued;
+    uint8_t* interruptFlag = nullptr;
+    void raiseOnFallingEdge(uint8_t before);
     
     bool up = false;
     bool down = false;
@@ -37,4 +66,29 @@ private:
 
     bool button_switch = false;
     bool direction_switch = false;
+};
+
+// Button changes collected from the host between two poll points, in
+// arrival order, stamped with the host time they happened at (ms). At a
+// poll point, which sits at a fixed cycle position, they become InputEvents
+// spread over the next interval by their host times, so what the game sees
+// does not depend on when the host thread happened to run.
+struct HostInputEvent {
+    uint32_t timeMs;
+    GbButton button;
+    bool pressed;
+};
+
+class HostInputQueue {
+public:
+    void push(uint32_t timeMs, GbButton button, bool pressed) { events.push_back({ timeMs, button, pressed }); }
+    // Queue everything in `memory`: the first event at cycle `base`, the
+    // others offset by their host time, capped to `span` cycles.
+    void stampInto(Memory& memory, uint64_t base, uint32_t span);
+    bool empty() const { return events.empty(); }
+    const std::vector<HostInputEvent>& pending() const { return events; }
+    void consume(size_t n) { events.erase(events.begin(), events.begin() + n); }  // handed on elsewhere
+
+private:
+    std::vector<HostInputEvent> events;
 };
\ No newline at end of file
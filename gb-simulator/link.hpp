@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "spsc.hpp"
+
+// One byte on the wire. The side providing the clock sends Data when its
+// transfer starts; the other side shifts it in and answers with a Reply
+// carrying the byte it shifted out.
+struct LinkMessage {
+    enum Kind : uint8_t { Data, Reply };
+    Kind kind;
+    uint8_t value;
+};
+
+// A link cable between two emulator instances in the same process: one
+// lock-free SPSC ring per direction, so each instance can run on its own
+// thread and only meets the other at transfer boundaries. Each End belongs
+// to exactly one emulation thread.
+class LinkCable {
+    using Ring = SpscRing<LinkMessage, 16>;
+
+public:
+    class End {
+    public:
+        bool send(const LinkMessage& m) { return out->push(m); }
+        bool receive(LinkMessage& m) { return in->pop(m); }
+
+        // A detached peer never answers; transfers then read 0xFF as with
+        // no cable plugged in.
+        void attach(bool on) { self->store(on, std::memory_order_release); }
+        bool peerAttached() const { return peer->load(std::memory_order_acquire); }
+
+    private:
+        friend class LinkCable;
+        Ring* out = nullptr;
+        Ring* in = nullptr;
+        std::atomic<bool>* self = nullptr;
+        std::atomic<bool>* peer = nullptr;
+    };
+
+    LinkCable()
+    {
+        for (int i = 0; i < 2; ++i) {
+            ends[i].out = &rings[i];
+            ends[i].in = &rings[1 - i];
+            ends[i].self = &attached[i];
+            ends[i].peer = &attached[1 - i];
+        }
+    }
+
+    LinkCable(const LinkCable&) = delete;
+    LinkCable& operator=(const LinkCable&) = delete;
+
+    End& end(int i) { return ends[i]; }   // 0 or 1
+
+private:
+    Ring rings[2];
+    std::atomic<bool> attached[2] { { false }, { false } };
+    End ends[2];
+};
@@ -1,5 +1,6 @@
 ﻿#include "memory.hpp"
 
+#include <cstring>
 #include <fstream>
 
 #include <iostream>
@@ -20,32 +21,9 @@ void Memory::reset()
     io_registers[0x06] = 0x00;   // TMA
     io_registers[0x07] = 0xF8;   // TAC (timer off, upper bits 1)
 
-    /*  Sound (power-on DMG values) */
-    io_registers[0x10] = 0x80;   // NR10
-    io_registers[0x11] = 0xBF;   // NR11
-    io_registers[0x12] = 0xF3;   // NR12
-    io_registers[0x13] = 0xFF;   // NR13
-    io_registers[0x14] = 0xBF;   // NR14
-
-    io_registers[0x16] = 0x3F;   // NR21
-    io_registers[0x17] = 0x00;   // NR22
-    io_registers[0x18] = 0xFF;   // NR23
-    io_registers[0x19] = 0xBF;   // NR24
-
-    io_registers[0x1A] = 0x7F;   // NR30
-    io_registers[0x1B] = 0xFF;   // NR31
-    io_registers[0x1C] = 0x9F;   // NR32
-    io_registers[0x1D] = 0xFF;   // NR33
-    io_registers[0x1E] = 0xBF;   // NR34
-
-    io_registers[0x20] = 0xFF;   // NR41
-    io_registers[0x21] = 0x00;   // NR42
-    io_registers[0x22] = 0x00;   // NR43
-    io_registers[0x23] = 0xBF;   // NR44
-
-    io_registers[0x24] = 0x77;   // NR50
-    io_registers[0x25] = 0xF3;   // NR51
-    io_registers[0x26] = 0xF1;   // NR52  (DMG: sound on, all channels off)
+    /*  Sound: NR10-NR52 and wave RAM live in the APU */
+    apu.reset();
+    scheduler.schedule(SchedEvent::AudioBlock, APU::BLOCK_CYCLES);
 
     /* LCD / PPU */
     io_registers[0x40] = 0x91;   // LCDC
@@ -67,9 +45,60 @@ void Memory::reset()
 
 
 
+void Memory::runEvents() {
+    SchedEvent ev;
+    while (scheduler.popDue(ev)) {
+        switch (ev) {
+        case SchedEvent::DmaDone: dma.complete(); break;
+        case SchedEvent::SerialDone: serial.complete(); break;
+        case SchedEvent::SerialPoll: serial.poll(); break;
+        case SchedEvent::AudioBlock:
+            apu.endBlock(scheduler.now());
+            scheduler.schedule(SchedEvent::AudioBlock, APU::BLOCK_CYCLES);
+            break;
+        case SchedEvent::InputDue:
+            input.applyQueued(scheduler.now());
+            scheduleInput();
+            break;
+        default: break;
+        }
+    }
+}
+
+void Memory::queueInput(uint64_t cycle, GbButton button, bool pressed) {
+    input.enqueue({ cycle, button, pressed });
+    scheduleInput();
+}
+
+void Memory::scheduleInput() {
+    if (!input.hasQueued()) {
+        scheduler.cancel(SchedEvent::InputDue);
+        return;
+    }
+    const uint64_t now = scheduler.now();
+    const uint64_t at = input.nextQueuedCycle();
+    scheduler.schedule(SchedEvent::InputDue, at > now ? at - now : 0);
+}
+
+void Memory::copyDmaSource(uint16_t address, uint8_t* out, int count) const {
+    if (address >= 0x8000 && address < 0xA000) {
+        std::memcpy(out, vram + (address - 0x8000), count);
+    }
+    else if (address >= 0xC000 && address < 0xE000) {
+        std::memcpy(out, wram + (address - 0xC000), count);
+    }
+    else {
+        for (int i = 0; i < count; ++i) {
+            uint16_t a = uint16_t(address + i);
+            out[i] = a < 0x8000 ? cartridge.getMBC()->readROM(a) : cartridge.getMBC()->readRAM(a);
+        }
+    }
+}
+
 void Memory::write(uint16_t address,uint8_t value) {
     
-    if ((dma.isActive()) && address >= 0xFE00 && address <= 0xFE9F)
+    // During OAM DMA, OAM and the bus the DMA reads from are unavailable
+    if (dma.isActive() && ((address >= 0xFE00 && address <= 0xFE9F) || dma.conflicts(address)))
         return ;
     if (address < 0x8000) {
         
@@ -77,7 +106,12 @@ void Memory::write(uint16_t address,uint8_t value) {
             
         }
     else if (address < 0xA000) {
-        vram[address - 0x8000] = value;
+        uint16_t offset = address - 0x8000;
+        if (vram[offset] != value) {
+            vram[offset] = value;
+            vramGen.touch(offset);
+            if (vramWriteHook) vramWriteHook(address, value);
+        }
     }
     else if (address < 0xC000) {
         cartridge.getMBC()->writeRAM(address, value);
@@ -92,13 +126,24 @@ void Memory::write(uint16_t address,uint8_t value) {
     }
     else if (address < 0xFF00) {
         
-        oam[address - 0xFE00] = value;
+        if (address <= 0xFE9F) {
+            oam[address - 0xFE00] = value;
+            oamCache.write(uint8_t(address - 0xFE00), value);
+        }
     }
     else if (address < 0xFF80) {
         if (address == 0xFF00) {
             input.write(value);
             return;
         }
+        if (address >= 0xFF10 && address <= 0xFF3F) { // APU
+            apu.write(address, value, scheduler.now());
+            return;
+        }
+        if (address == 0xFF02) { // SC: may start a transfer
+            serial.writeControl(value, this);
+            return;
+        }
         if (address == 0xFF46) { // DMA transfer
             dma.start(value, this);
             io_registers[0x46] = value;
@@ -106,11 +151,8 @@ void Memory::write(uint16_t address,uint8_t value) {
         }
         uint16_t offset = address - 0xFF00;
 
-        // Serial output triggered
-        if (address == 0xFF02 && value == 0x81) {
-            char c = static_cast<char>(io_registers[0x01]);  // offset 0x01 = SB (0xFF01)
-            std::cout << c << std::flush;
-        }
+        if (address >= 0xFF40 && address <= 0xFF4B && lcdWriteHook)
+            lcdWriteHook(address, value);
 
         io_registers[offset] = value;
     }
@@ -123,8 +165,12 @@ void Memory::write(uint16_t address,uint8_t value) {
 }
 
 uint8_t Memory::read(uint16_t address) const {
-    if ((dma.isActive()) && address >= 0xFE00 && address <= 0xFE9F)
-        return 0xFF;
+    if (dma.isActive()) {
+        if (address >= 0xFE00 && address <= 0xFE9F)
+            return 0xFF;
+        if (dma.conflicts(address))
+            return dma.busByte();      // bus conflict: the byte in flight
+    }
     if (address < 0x8000) {
         
         return cartridge.getMBC()->readROM(address);
@@ -152,6 +198,9 @@ uint8_t Memory::read(uint16_t address) const {
         if (address == 0xFF00) {
             return input.get_input();
         }
+        if (address >= 0xFF10 && address <= 0xFF3F) {
+            return apu.read(address, scheduler.now());
+        }
         return io_registers[address - 0xFF00];
     }
     else if (address < 0xFFFF) {
@@ -1,11 +1,17 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
+#include "apu.hpp"
 #include "dma.hpp"
+#include "scheduler.hpp"
+#include "serial.hpp"
 #include "input.hpp"
 #include "cartridge.hpp"
+#include "oamcache.hpp"
+#include "vramgen.hpp"
 
 
 const uint8_t bootDMG[256] = {
@@ -36,7 +42,8 @@ public:
 		std::fill(std::begin(oam), std::end(oam), 0);
 		std::fill(std::begin(io_registers), std::end(io_registers), 0);
 		std::fill(std::begin(hram), std::end(hram), 0);
-		serialBuffer.clear();
+		oamCache.reload(oam);
+		input.connectInterrupt(&io_registers[0x0F]);
 
 		interrupt_enable = 0;
 		reset();
@@ -51,6 +58,17 @@ public:
 	uint8_t read(uint16_t address) const;
 	void write(uint16_t address, uint8_t value);
 	bool loadROM(const std::string& filename);
+
+	// Advance the M-cycle clock by one instruction and run whatever came due.
+	void tick(uint32_t cycles)
+	{
+		scheduler.advance(cycles);
+		if (scheduler.anyDue()) runEvents();
+	}
+
+	// Read DMA source bytes without the DMA bus checks. Plain memory (VRAM,
+	// WRAM) is block-copied; ROM and cartridge RAM go through the MBC.
+	void copyDmaSource(uint16_t address, uint8_t* out, int count) const;
 	inline void requestInterrupt(uint8_t mask)
 	{
 		// IF is I/O register index 0x0F within 0xFF00-0xFF7F
@@ -59,19 +77,51 @@ public:
 
 	bool oamBlocked = false;
 
-	std::vector<char> serialBuffer;
+	// Told about every write to the LCD registers 0xFF40-0xFF4B before it
+	// lands, so the PPU can log raster effects made during mode 3.
+	std::function<void(uint16_t, uint8_t)> lcdWriteHook;
+
+	// Told about every write that changes a VRAM byte, after it lands.
+	std::function<void(uint16_t, uint8_t)> vramWriteHook;
+
+	// Bytes shifted out through SB always land in serialLog, and are also
+	// passed to serialSink if one is set (not owned; must outlive Memory).
+	SerialRingSink serialLog;
+	void setSerialSink(SerialSink* sink) { serialSink = sink; }
+	void serialOut(uint8_t byte)
+	{
+		serialLog.put(byte);
+		if (serialSink) serialSink->put(byte);
+	}
+
+	// Press or release a button when the scheduler clock reaches `cycle`
+	// (see InputEvent). A stamp already in the past applies at the next
+	// instruction boundary.
+	void queueInput(uint64_t cycle, GbButton button, bool pressed);
+
+	// Plug this Game Boy into one end of a link cable (nullptr unplugs).
+	void connectLink(LinkCable::End* end) { serial.connect(end, this); }
 	uint8_t io_registers[0x80];     // 128 bytes of I/O
 
 	uint8_t* oamPtr() { return oam; }
 	uint8_t* vramPtr() { return vram; }
 
+	Scheduler scheduler;	// M-cycle clock and pending events
 	DMA dma;				// DMA transfer state
+	SerialPort serial;		// SB/SC transfers, optionally over a link cable
+	mutable APU apu;		// sound; reading NR52 catches it up
+	OAMCache oamCache;		// decoded OAM + per-line sprite buckets
+	VRAMGenerations vramGen;	// per-tile / per-map-entry write counters
 	Input input;
 	Cartridge cartridge;
 
 
 private:
 	void reset();
+	void runEvents();
+	void scheduleInput();
+
+	SerialSink* serialSink = nullptr;
 
 
 
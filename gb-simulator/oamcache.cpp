@@ -0,0 +1,58 @@
+#include "oamcache.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+
+void OAMCache::write(uint8_t offset, uint8_t value)
+{
+    Sprite& s = sprites[offset >> 2];
+    switch (offset & 0x03) {
+    case 0: {
+        int16_t y = int16_t(value) - 16;
+        if (s.y != y) bucketHeight = 0;        // line coverage changed
+        s.y = y;
+        break;
+    }
+    case 1: s.x = int16_t(value) - 8; break;
+    case 2: s.tile = value; break;
+    case 3: s.attr = value; break;
+    }
+}
+
+void OAMCache::reload(const uint8_t* oam)
+{
+    for (int i = 0; i < 40; ++i) {
+        sprites[i] = {
+            int16_t(int16_t(oam[i * 4 + 1]) - 8),
+            int16_t(int16_t(oam[i * 4]) - 16),
+            oam[i * 4 + 2],
+            oam[i * 4 + 3]
+        };
+    }
+    bucketHeight = 0;
+}
+
+int OAMCache::lineSprites(int line, int height, const uint8_t*& indices)
+{
+    if (bucketHeight != height) rebuild(height);   // 8x16 mode toggles too
+    indices = bucket[line];
+    return bucketCount[line];
+}
+
+// Walk OAM in order so each line keeps the first 10 sprites it would have
+// found during a real mode-2 scan.
+void OAMCache::rebuild(int height)
+{
+    std::fill(std::begin(bucketCount), std::end(bucketCount), 0);
+
+    for (int i = 0; i < 40; ++i) {
+        int first = std::max<int>(0, sprites[i].y);
+        int last = std::min<int>(143, sprites[i].y + height - 1);
+        for (int line = first; line <= last; ++line) {
+            if (bucketCount[line] < 10)
+                bucket[line][bucketCount[line]++] = uint8_t(i);
+        }
+    }
+    bucketHeight = height;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Decoded mirror of OAM (0xFE00-0xFE9F) plus an index of the sprites that
+// intersect each visible line. OAM is usually rewritten once per frame by
+// DMA but searched on all 144 lines, so the per-line buckets are rebuilt
+// lazily on the first lookup after a Y coordinate changes.
+class OAMCache {
+public:
+    struct Sprite { int16_t x, y; uint8_t tile, attr; };   // screen-space x/y
+
+    void write(uint8_t offset, uint8_t value);   // offset 0x00-0x9F
+    void reload(const uint8_t* oam);             // whole table, e.g. after DMA
+
+    // OAM indices (in OAM order, at most 10) of the sprites covering `line`.
+    int lineSprites(int line, int height, const uint8_t*& indices);
+    const Sprite& sprite(int index) const { return sprites[index]; }
+
+private:
+    Sprite sprites[40] {};
+
+    uint8_t bucket[144][10] {};
+    uint8_t bucketCount[144] {};
+    int bucketHeight = 0;    // sprite height the buckets were built for, 0 = stale
+
+    void rebuild(int height);
+};
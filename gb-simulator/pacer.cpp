@@ -0,0 +1,116 @@
+#include "pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+
+const char* pacingModeName(PacingMode mode)
+{
+    switch (mode) {
+    case PacingMode::FreeRunning: return "59.73 Hz";
+    case PacingMode::VsyncLocked: return "vsync";
+    case PacingMode::Speed2x:     return "2x";
+    case PacingMode::Speed4x:     return "4x";
+    case PacingMode::Unlimited:   return "unlimited";
+    default:                      return "?";
+    }
+}
+
+void FramePacer::setMode(PacingMode mode)
+{
+    currentMode.store(mode, std::memory_order_relaxed);
+    vsyncSignal.notify_one();       // don't leave frameDone() waiting for a vsync
+}
+
+void FramePacer::frameDone()
+{
+    const PacingMode m = mode();
+
+    if (m == PacingMode::VsyncLocked) {
+        waitVsync();
+    }
+    else if (m != PacingMode::Unlimited) {
+        const int speed = (m == PacingMode::Speed4x) ? 4 : (m == PacingMode::Speed2x) ? 2 : 1;
+        const auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / (DMG_FPS * speed)));
+
+        // Deadlines advance by exact periods so the average rate is exact;
+        // after a mode change, or when far behind (debugger, suspend), start
+        // over from now instead of racing to catch up.
+        const auto now = Clock::now();
+        if (m != pacedMode || now > deadline + 4 * period)
+            deadline = now;
+        deadline += period;
+        sleepUntil(deadline);
+    }
+    pacedMode = m;
+
+    record(Clock::now());
+}
+
+void FramePacer::sleepUntil(Clock::time_point t) const
+{
+    const auto now = Clock::now();
+    if (t - now > SPIN_SLICE)
+        std::this_thread::sleep_for(t - now - SPIN_SLICE);
+    while (Clock::now() < t)
+        std::this_thread::yield();
+}
+
+void FramePacer::vsyncTick()
+{
+    {
+        std::lock_guard<std::mutex> lock(vsyncMutex);
+        ++vsyncCount;
+    }
+    vsyncSignal.notify_one();
+}
+
+// Wait for a refresh newer than the last one a frame was paced to. If the
+// presenting thread stops ticking (window minimized, mode switched away)
+// fall back to the DMG period.
+void FramePacer::waitVsync()
+{
+    std::unique_lock<std::mutex> lock(vsyncMutex);
+    vsyncSignal.wait_for(lock, std::chrono::milliseconds(17), [&] {
+        return vsyncCount > vsyncSeen || mode() != PacingMode::VsyncLocked;
+    });
+    vsyncSeen = vsyncCount;
+}
+
+void FramePacer::record(Clock::time_point now)
+{
+    if (lastFrame != Clock::time_point {}) {
+        const double ms = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+        std::lock_guard<std::mutex> lock(statsMutex);
+        intervals[intervalNext] = ms;
+        intervalNext = (intervalNext + 1) % WINDOW;
+        intervalCount = std::min(intervalCount + 1, WINDOW);
+    }
+    lastFrame = now;
+}
+
+FramePacer::Stats FramePacer::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    Stats s;
+    s.frames = intervalCount;
+    if (intervalCount == 0) return s;
+
+    double sum = 0;
+    s.minMs = s.maxMs = intervals[0];
+    for (int i = 0; i < intervalCount; ++i) {
+        sum += intervals[i];
+        s.minMs = std::min(s.minMs, intervals[i]);
+        s.maxMs = std::max(s.maxMs, intervals[i]);
+    }
+    s.meanMs = sum / intervalCount;
+
+    double var = 0;
+    for (int i = 0; i < intervalCount; ++i)
+        var += (intervals[i] - s.meanMs) * (intervals[i] - s.meanMs);
+    s.jitterMs = std::sqrt(var / intervalCount);
+    s.fps = s.meanMs > 0 ? 1000.0 / s.meanMs : 0;
+    return s;
+}
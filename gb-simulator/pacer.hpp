@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// How the emulation thread is throttled.
+enum class PacingMode {
+    FreeRunning,    // the DMG's own 59.7275 Hz on the host's monotonic clock
+    VsyncLocked,    // one emulated frame per display refresh (see vsyncTick)
+    Speed2x,
+    Speed4x,
+    Unlimited,      // no throttling at all
+    Count
+};
+
+const char* pacingModeName(PacingMode mode);
+
+// Frame pacer for the emulation thread. frameDone() blocks until the next
+// frame is due: it sleeps for most of the wait, then spins for the last
+// slice, since OS sleeps overshoot by up to a scheduler tick. setMode() and
+// vsyncTick() may be called from the presenting thread at any time.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr double DMG_FPS = 4194304.0 / 70224.0;   // 59.7275 Hz
+
+    explicit FramePacer(PacingMode mode = PacingMode::FreeRunning) : currentMode(mode) {}
+
+    void setMode(PacingMode mode);
+    PacingMode mode() const { return currentMode.load(std::memory_order_relaxed); }
+
+    // Emulation thread: one emulated frame has been produced.
+    void frameDone();
+
+    // Presenting thread, VsyncLocked only: a vsynced present just returned.
+    void vsyncTick();
+
+    // Measured time between frameDone() returns over the last WINDOW frames.
+    struct Stats {
+        double meanMs = 0;
+        double jitterMs = 0;        // standard deviation
+        double minMs = 0;
+        double maxMs = 0;
+        double fps = 0;
+        int frames = 0;
+    };
+    Stats stats() const;
+
+private:
+    // Time left to spinning instead of sleeping
+    static constexpr std::chrono::microseconds SPIN_SLICE { 2000 };
+
+    std::atomic<PacingMode> currentMode;
+
+    // Emulation thread only
+    Clock::time_point deadline {};
+    PacingMode pacedMode = PacingMode::Count;     // mode of the previous frame
+    Clock::time_point lastFrame {};
+
+    // Vsync handshake
+    std::mutex vsyncMutex;
+    std::condition_variable vsyncSignal;
+    uint64_t vsyncCount = 0;
+    uint64_t vsyncSeen = 0;
+
+    static constexpr int WINDOW = 120;
+    mutable std::mutex statsMutex;
+    double intervals[WINDOW] {};
+    int intervalCount = 0;
+    int intervalNext = 0;
+
+    void sleepUntil(Clock::time_point t) const;
+    void waitVsync();
+    void record(Clock::time_point now);
+};
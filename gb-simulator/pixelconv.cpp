@@ -0,0 +1,99 @@
+#include "pixelconv.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GB_PIXELCONV_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+const uint32_t dmgPaletteARGB[4] = {
+    0xFFe0f8d0,   // lightest
+    0xFF88c070,
+    0xFF346856,
+    0xFF081820    // darkest
+};
+
+const uint16_t dmgPaletteRGB565[4] = { 0xE7DA, 0x8E0E, 0x334A, 0x08C4 };
+
+const uint8_t grayPalette[4] = { 0xFF, 0xAA, 0x55, 0x00 };
+
+
+// Each block below picks palette[k] wherever shade == k with a compare and
+// mask per palette entry; with only four shades that beats a gather.
+
+void convertToARGB8888(const uint8_t* shades, uint32_t* out, size_t count,
+                       const uint32_t palette[4])
+{
+    size_t i = 0;
+#ifdef GB_PIXELCONV_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pal[4], key[4];
+    for (int k = 0; k < 4; ++k) {
+        pal[k] = _mm_set1_epi32(int(palette[k]));
+        key[k] = _mm_set1_epi32(k);
+    }
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shades + i));
+        __m128i w[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+        for (int h = 0; h < 2; ++h) {
+            __m128i d[2] = { _mm_unpacklo_epi16(w[h], zero), _mm_unpackhi_epi16(w[h], zero) };
+            for (int q = 0; q < 2; ++q) {
+                __m128i px = _mm_and_si128(_mm_cmpeq_epi32(d[q], key[0]), pal[0]);
+                for (int k = 1; k < 4; ++k)
+                    px = _mm_or_si128(px, _mm_and_si128(_mm_cmpeq_epi32(d[q], key[k]), pal[k]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + h * 8 + q * 4), px);
+            }
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = palette[shades[i] & 0x03];
+}
+
+void convertToRGB565(const uint8_t* shades, uint16_t* out, size_t count,
+                     const uint16_t palette[4])
+{
+    size_t i = 0;
+#ifdef GB_PIXELCONV_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pal[4], key[4];
+    for (int k = 0; k < 4; ++k) {
+        pal[k] = _mm_set1_epi16(short(palette[k]));
+        key[k] = _mm_set1_epi16(short(k));
+    }
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shades + i));
+        __m128i w[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+        for (int h = 0; h < 2; ++h) {
+            __m128i px = _mm_and_si128(_mm_cmpeq_epi16(w[h], key[0]), pal[0]);
+            for (int k = 1; k < 4; ++k)
+                px = _mm_or_si128(px, _mm_and_si128(_mm_cmpeq_epi16(w[h], key[k]), pal[k]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + h * 8), px);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = palette[shades[i] & 0x03];
+}
+
+void convertToGray8(const uint8_t* shades, uint8_t* out, size_t count,
+                    const uint8_t palette[4])
+{
+    size_t i = 0;
+#ifdef GB_PIXELCONV_SSE2
+    __m128i pal[4], key[4];
+    for (int k = 0; k < 4; ++k) {
+        pal[k] = _mm_set1_epi8(char(palette[k]));
+        key[k] = _mm_set1_epi8(char(k));
+    }
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shades + i));
+        __m128i px = _mm_and_si128(_mm_cmpeq_epi8(v, key[0]), pal[0]);
+        for (int k = 1; k < 4; ++k)
+            px = _mm_or_si128(px, _mm_and_si128(_mm_cmpeq_epi8(v, key[k]), pal[k]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), px);
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = palette[shades[i] & 0x03];
+}
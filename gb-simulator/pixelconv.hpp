@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversion of the PPU's 8-bit shade framebuffer (values 0-3, lightest to
+// darkest) into host pixel formats. The PPU never touches these; whoever
+// presents, encodes or exports a frame converts it once, 16 pixels at a
+// time where SSE2 is available.
+
+// DMG greens in sRGB (ARGB 0xFFrrggbb), lightest first.
+extern const uint32_t dmgPaletteARGB[4];
+extern const uint16_t dmgPaletteRGB565[4];
+extern const uint8_t  grayPalette[4];     // 0xFF, 0xAA, 0x55, 0x00
+
+void convertToARGB8888(const uint8_t* shades, uint32_t* out, size_t count,
+                       const uint32_t palette[4] = dmgPaletteARGB);
+void convertToRGB565(const uint8_t* shades, uint16_t* out, size_t count,
+                     const uint16_t palette[4] = dmgPaletteRGB565);
+void convertToGray8(const uint8_t* shades, uint8_t* out, size_t count,
+                    const uint8_t palette[4] = grayPalette);
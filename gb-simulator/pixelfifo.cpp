@@ -0,0 +1,210 @@
+#include "pixelfifo.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+
+void PixelFifo::start(const uint8_t* vramPtr, const uint8_t* ioPtr, int ly, int winLine,
+                      const Sprite* spriteList, int count, uint8_t* outRow)
+{
+    vram = vramPtr;
+    io = ioPtr;
+    out = outRow;
+    line = ly;
+    windowLine = winLine;
+
+    sprites = spriteList;
+    spriteCount = count;
+    std::fill(std::begin(spriteFetched), std::end(spriteFetched), false);
+    pendingSprite = -1;
+    spriteDots = 0;
+
+    step = GET_TILE;
+    stepDots = 0;
+    fetcherX = 0;
+    startupDots = 6;
+    inWindow = false;
+
+    bgHead = bgCount = 0;
+    std::fill(std::begin(objFifo), std::end(objFifo), ObjPixel{ 0, 0, 0 });
+
+    discard = io[0x43] & 0x07;
+    lx = 0;
+}
+
+int PixelFifo::run(int dots)
+{
+    int used = 0;
+    while (used < dots && !done()) {
+        tick();
+        ++used;
+    }
+    return used;
+}
+
+void PixelFifo::tick()
+{
+    const uint8_t lcdc = io[0x40];
+
+    // The first tile fetch of every line is thrown away (6 dots)
+    if (startupDots > 0) {
+        --startupDots;
+        return;
+    }
+
+    // 1) Window start: restart the fetcher on the window map
+    if (!inWindow && (lcdc & 0x20) && (lcdc & 0x01) && line >= io[0x4A]) {
+        int wx = int(io[0x4B]) - 7;
+        if (lx >= wx && wx < 160) {
+            inWindow = true;
+            bgHead = bgCount = 0;
+            step = GET_TILE;
+            stepDots = 0;
+            fetcherX = 0;
+            discard = wx < 0 ? -wx : 0;
+        }
+    }
+
+    // 2) An OBJ starting at this pixel stalls output while it is fetched
+    if (pendingSprite < 0 && (lcdc & 0x02)) {
+        for (int i = 0; i < spriteCount; ++i) {
+            if (!spriteFetched[i] && sprites[i].x <= lx && sprites[i].x < 160) {
+                pendingSprite = i;
+                break;
+            }
+        }
+    }
+    if (pendingSprite >= 0) {
+        if (step != PUSH) {               // let the BG fetch finish first
+            advanceFetcher();
+            return;
+        }
+        if (++spriteDots < 6) return;
+        fetchSprite(sprites[pendingSprite]);
+        spriteFetched[pendingSprite] = true;
+        pendingSprite = -1;
+        spriteDots = 0;
+        return;
+    }
+
+    // 3) BG/window fetcher
+    advanceFetcher();
+
+    // 4) Shift one pixel out
+    if (bgCount == 0) return;
+    uint8_t bg = bgFifo[bgHead];
+    bgHead = (bgHead + 1) & 0x07;
+    --bgCount;
+    if (discard > 0) {
+        --discard;
+        return;
+    }
+
+    ObjPixel obj = objFifo[0];
+    std::copy(std::begin(objFifo) + 1, std::end(objFifo), std::begin(objFifo));
+    objFifo[7] = { 0, 0, 0 };
+
+    if (!(lcdc & 0x01)) bg = 0;          // BG/window blanked on DMG
+    uint8_t shade;
+    if (obj.colour != 0 && (lcdc & 0x02) && !(obj.priority && bg != 0)) {
+        uint8_t pal = io[(obj.palTag & 0x20) ? 0x49 : 0x48];
+        shade = (pal >> (obj.colour * 2)) & 0x03;
+    }
+    else {
+        shade = (io[0x47] >> (bg * 2)) & 0x03;
+    }
+    if (out) out[lx] = shade;
+    ++lx;
+}
+
+// Byte offset in VRAM of the current row of the tile being fetched.
+uint16_t PixelFifo::tileDataOffset() const
+{
+    const uint8_t lcdc = io[0x40];
+    int row = inWindow ? (windowLine & 0x07) : ((line + io[0x42]) & 0x07);
+    uint16_t base = (lcdc & 0x10) ? tileNumber * 16
+                                  : uint16_t(0x1000 + int8_t(tileNumber) * 16);
+    return uint16_t(base + row * 2);
+}
+
+void PixelFifo::advanceFetcher()
+{
+    const uint8_t lcdc = io[0x40];
+
+    switch (step) {
+    case GET_TILE:
+        if (++stepDots < 2) break;
+        if (inWindow) {
+            uint16_t map = (lcdc & 0x40) ? 0x1C00 : 0x1800;
+            tileNumber = vram[map + (windowLine >> 3) * 32 + (fetcherX & 31)];
+        }
+        else {
+            uint16_t map = (lcdc & 0x08) ? 0x1C00 : 0x1800;
+            int col = ((io[0x43] >> 3) + fetcherX) & 31;
+            int row = ((line + io[0x42]) & 0xFF) >> 3;
+            tileNumber = vram[map + row * 32 + col];
+        }
+        step = DATA_LOW;
+        stepDots = 0;
+        break;
+
+    case DATA_LOW:
+        if (++stepDots < 2) break;
+        dataLow = vram[tileDataOffset()];
+        step = DATA_HIGH;
+        stepDots = 0;
+        break;
+
+    case DATA_HIGH:
+        if (++stepDots < 2) break;
+        dataHigh = vram[tileDataOffset() + 1];
+        step = PUSH;
+        stepDots = 0;
+        break;
+
+    case PUSH:
+        if (bgCount != 0) break;          // DMG pushes only into an empty FIFO
+        for (int px = 0; px < 8; ++px) {
+            int bit = 7 - px;
+            bgFifo[px] = ((dataHigh >> bit) & 1) << 1 | ((dataLow >> bit) & 1);
+        }
+        bgHead = 0;
+        bgCount = 8;
+        ++fetcherX;
+        step = GET_TILE;
+        break;
+    }
+}
+
+// Merge one sprite row into the OBJ FIFO. Pixels already holding an opaque
+// OBJ pixel keep it: lower X (then OAM order) wins on DMG.
+void PixelFifo::fetchSprite(const Sprite& sp)
+{
+    const int spriteH = (io[0x40] & 0x04) ? 16 : 8;
+
+    int row = line - sp.y;
+    if (sp.attr & 0x40) row = spriteH - 1 - row;
+
+    uint8_t tile = sp.tile;
+    if (spriteH == 16) tile &= 0xFE;
+    if (spriteH == 16 && row >= 8) {
+        tile += 1;
+        row -= 8;
+    }
+    if (row < 0 || row > 7) return;
+
+    uint8_t lo = vram[tile * 16 + row * 2];
+    uint8_t hi = vram[tile * 16 + row * 2 + 1];
+    bool xFlip = sp.attr & 0x20;
+    uint8_t palTag = 0x10 | ((sp.attr & 0x10) ? 0x20 : 0x00);
+    uint8_t priority = (sp.attr & 0x80) ? 1 : 0;
+
+    for (int px = 0; px < 8; ++px) {
+        int slot = sp.x + px - lx;
+        if (slot < 0 || slot > 7) continue;   // clipped on the left
+        int bit = xFlip ? px : (7 - px);
+        uint8_t colour = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
+        if (colour != 0 && objFifo[slot].colour == 0)
+            objFifo[slot] = { colour, palTag, priority };
+    }
+}
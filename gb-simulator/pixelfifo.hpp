@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include "oamcache.hpp"
+
+// Dot-accurate mode-3 pixel pipeline: BG/window fetcher (tile, data low,
+// data high, push), BG and OBJ FIFOs, sprite fetch stalls and the window
+// restart. Registers are read live from the I/O block on every fetch, so
+// mid-line raster effects come out as on hardware, and the mode-3 length is
+// whatever the pipeline takes to push 160 pixels.
+//
+// Only compiled into the PPU when GB_PIXEL_FIFO is defined; the default
+// scanline renderer does not carry any of this.
+class PixelFifo {
+public:
+    using Sprite = OAMCache::Sprite;
+
+    // `out` receives 160 shades (0-3); nullptr runs the timing only.
+    void start(const uint8_t* vram, const uint8_t* io, int line, int windowLine,
+               const Sprite* sprites, int spriteCount, uint8_t* out);
+
+    // Advance up to `dots` dots; returns how many were used. Stops early
+    // once the last pixel of the line is out.
+    int run(int dots);
+
+    bool done() const { return lx == 160; }
+    bool windowUsed() const { return inWindow; }
+
+private:
+    enum FetchStep : uint8_t { GET_TILE, DATA_LOW, DATA_HIGH, PUSH };
+    struct ObjPixel { uint8_t colour, palTag, priority; };
+
+    const uint8_t* vram = nullptr;
+    const uint8_t* io = nullptr;    // io[0] == 0xFF00
+    uint8_t* out = nullptr;
+    int line = 0;
+    int windowLine = 0;
+
+    const Sprite* sprites = nullptr;
+    int spriteCount = 0;
+    bool spriteFetched[10] {};
+    int pendingSprite = -1;         // sprite stalling the pipeline, -1 = none
+    int spriteDots = 0;
+
+    // BG fetcher
+    FetchStep step = GET_TILE;
+    int stepDots = 0;
+    int fetcherX = 0;               // tile column within the map row
+    uint8_t tileNumber = 0, dataLow = 0, dataHigh = 0;
+    int startupDots = 0;            // the discarded first fetch
+    bool inWindow = false;
+
+    // FIFOs
+    uint8_t bgFifo[8] {};
+    int bgHead = 0, bgCount = 0;
+    ObjPixel objFifo[8] {};         // [0] lines up with the next output pixel
+
+    int discard = 0;                // SCX fine scroll / WX < 7 pixels to drop
+    int lx = 0;                     // pixels output so far
+
+    void tick();
+    void advanceFetcher();
+    void fetchSprite(const Sprite& sp);
+    uint16_t tileDataOffset() const;
+};
@@ -1,8 +1,27 @@
 #include "ppu.hpp"
 #include "memory.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "hash.hpp"
 
 
+PPU::~PPU()
+{
+    if (renderThread.joinable()) {
+        renderQuit = true;
+        renderWake.notify_one();
+        renderThread.join();
+    }
+}
+
+void PPU::connectMemory(Memory* memoryPtr)
+{
+    memory = memoryPtr;
+    memory->lcdWriteHook = [this](uint16_t address, uint8_t value) {
+        registerWritten(address, value);
+    };
+}
 
 bool PPU::inOAMRestrictedMode() const {
     return mode == 2 || mode == 3;
@@ -10,34 +29,19 @@ bool PPU::inOAMRestrictedMode() const {
 
 
 // -----------------------------------------------------------------------------
-//  Convert a 2-bit colour index (plus BG/OBJ tags) to 32-bit RGB.
+//  Fill a lookup table from a 2-bit colour index (plus BG/OBJ tags) to the
+//  shade 0-3 the palettes select for it. Built once per span.
 //  Bits 0-1 : colour index 0-3
 //  Bit 4    : 0 = BG/Window pixel, 1 = OBJ pixel
 //  Bit 5    : (when bit 4 = 1) 0 = OBP0, 1 = OBP1
 // -----------------------------------------------------------------------------
-uint32_t PPU::mapColor(uint8_t pix) const
+void PPU::loadShadeTable(const LineRegs& regs, uint8_t table[0x40])
 {
-    // ----- 1.  Select the right palette register -----------------------------
-    uint8_t palReg;
-    if (pix & 0x10) {                                  // sprite pixel
-        palReg = memory->read((pix & 0x20) ? 0xFF49     // OBP1
-            : 0xFF48);  // OBP0
+    for (int c = 0; c < 4; ++c) {
+        table[0x00 | c] = (regs.bgp >> (c * 2)) & 0x03;
+        table[0x10 | c] = (regs.obp0 >> (c * 2)) & 0x03;
+        table[0x30 | c] = (regs.obp1 >> (c * 2)) & 0x03;
     }
-    else {                                           // background/window
-        palReg = memory->read(0xFF47);                  // BGP
-    }
-
-    // ----- 2.  Extract the shade (0-3) from the palette -----------------------
-    uint8_t shade = (palReg >> ((pix & 0x03) * 2)) & 0x03;
-
-    // ----- 3.  DMG greens in sRGB (ARGB 0xFFrrggbb) --------------------------
-    static constexpr uint32_t dmg[4] = {
-        0xFFe0f8d0,   // lightest
-        0xFF88c070,
-        0xFF346856,
-        0xFF081820    // darkest
-    };
-    return dmg[shade];
 }
 
 //------------------------------------------------------------------------------
@@ -63,56 +67,626 @@ int PPU::calculateDrawPenalties() const
         }
     }
 
-    //  3)  Sprite stalls: 6 dots per visible OBJ (good heuristic) 
-    if (lcdc & 0x02) {                                            // OBJ enable
-        int count = 0;
-        int h = spriteHeight();
-        for (int i = 0; i < 40 && count < 10; ++i) {
-            uint16_t spriteY = memory->read(0xFE00 + i * 4) - 16;
-            if (currentLine >= spriteY && currentLine < spriteY + h)
-                ++count;
+    //  3)  Sprite stalls: 6 dots per visible OBJ (good heuristic)
+    if (lcdc & 0x02)                                              // OBJ enable
+        penalty += lineSpriteCount * 6;                           // 0-60 dots
+    return penalty;                                               // 0-73+ dots
+}
+
+//------------------------------------------------------------------------------
+//  Mode-2 OAM search: pick up to 10 sprites overlapping this line, once.
+//  The list drives both the mode-3 length and scanlineSprite().
+//------------------------------------------------------------------------------
+void PPU::oamSearch()
+{
+    lineSpriteCount = 0;
+    if (memory->dma.isActive()) return;  // OAM reads back 0xFF during DMA
+
+    // 1) Up to 10 sprites that overlap this line (OAM order), pre-bucketed
+    const uint8_t* indices;
+    int n = memory->oamCache.lineSprites(currentLine, spriteHeight(), indices);
+    for (int i = 0; i < n; ++i) {
+        const OAMCache::Sprite& s = memory->oamCache.sprite(indices[i]);
+        lineSprites[lineSpriteCount++] = { s.x, s.y, s.tile, s.attr };
+    }
+
+    // 2) Sort by X (lower X first; ties keep OAM order)
+    std::stable_sort(lineSprites, lineSprites + lineSpriteCount,
+        [](const SpriteEntry& a, const SpriteEntry& b) { return a.x < b.x; }
+    );
+}
+
+
+
+void PPU::lcdTurnedOff()
+{
+    lcdOn = false;
+    mode = HBLANK;
+    modeClock = 0;
+    currentLine = 0;
+    windowLine = -1;
+
+    memory->write(0xFF44, 0);
+    memory->write(0xFF41, memory->read(0xFF41) & 0xFC);   // STAT mode 0
+    memory->oamBlocked = false;
+
+    // The panel goes blank; hand that frame to the frontend once
+    if (frameMode == RenderMode::Threaded)
+        pushCommand({ RenderCommand::LcdOff });
+    else
+        publishBlankFrame();
+    resetCapture();         // lines of the interrupted frame are dropped
+}
+
+void PPU::publishBlankFrame()
+{
+    Frame& blank = frames.back();
+    for (auto& row : blank.pixels)
+        std::fill(std::begin(row), std::end(row), 0);
+    std::fill(std::begin(blank.lineSig), std::end(blank.lineSig), 0);
+    std::fill(std::begin(lastLineSig), std::end(lastLineSig), 0);
+    blank.changedLines.set();
+    frames.publish();
+    frameReady = true;
+}
+
+// Restart at the top of a frame. No mode-2 STAT interrupt is raised for the
+// first line, and the first frame after enabling is not shown on a DMG.
+void PPU::lcdTurnedOn()
+{
+    lcdOn = true;
+    currentLine = 0;
+    windowLine = -1;
+    modeClock = 0;
+    mode = OAM_SEARCH;
+
+    memory->write(0xFF41, (memory->read(0xFF41) & 0xFC) | OAM_SEARCH);
+    checkCoincidence();
+
+    // The first frame is never drawn, so it is not one the skip counter or
+    // a pending requestFrame() should be spent on: only set up the mode.
+    renderingFrame = false;
+    switchFrameMode();
+    resetCapture();
+}
+
+// Decide whether the frame starting at LY = 0 gets drawn at all.
+void PPU::beginFrame()
+{
+    if (renderOnRequest) {
+        renderingFrame = frameRequested;
+        frameRequested = false;
+    }
+    else {
+        renderingFrame = (frameCounter % frameSkip) == 0;
+    }
+    ++frameCounter;
+    switchFrameMode();
+    resetCapture();
+}
+
+//------------------------------------------------------------------------------
+//  Mid-line register writes. Memory forwards every LCDC..WX write here; the
+//  ones landing in mode 3 are logged with the pixel X they take effect at,
+//  and renderScanline() splits the line into spans between them.
+//------------------------------------------------------------------------------
+void PPU::latchLineRegs()
+{
+    lineRegs = {
+        memory->read(0xFF40), memory->read(0xFF42), memory->read(0xFF43),
+        memory->read(0xFF47), memory->read(0xFF48), memory->read(0xFF49),
+        memory->read(0xFF4A), memory->read(0xFF4B)
+    };
+    lineWriteCount = 0;
+}
+
+void PPU::registerWritten(uint16_t address, uint8_t value)
+{
+    if (mode != DRAWING || !lcdOn || !renderingFrame) return;  // latched at next line
+    if (address == 0xFF41 || address == 0xFF44 || address == 0xFF45 || address == 0xFF46)
+        return;                                  // no effect on pixels
+    if (lineWriteCount == MAX_LINE_WRITES) return;
+
+    // Pixels leave the FIFO ~12 dots into mode 3, after the SCX fine-scroll
+    // discard. Sprite stalls are ignored, so this is a close estimate.
+    int x = modeClock - 12 - (lineRegs.scx & 0x07);
+    x = std::clamp(x, 0, 160);
+    lineWrites[lineWriteCount++] = { uint8_t(x), uint8_t(address - 0xFF40), value };
+}
+
+void PPU::applyRegWrite(LineRegs& regs, const RegWrite& w)
+{
+    switch (w.reg) {
+    case LCDC: regs.lcdc = w.value; break;
+    case SCY:  regs.scy = w.value; break;
+    case SCX:  regs.scx = w.value; break;
+    case BGP:  regs.bgp = w.value; break;
+    case OBP0: regs.obp0 = w.value; break;
+    case OBP1: regs.obp1 = w.value; break;
+    case WY:   regs.wy = w.value; break;
+    case WX:   regs.wx = w.value; break;
+    }
+}
+
+//------------------------------------------------------------------------------
+//  Line signature: a hash of everything the line is drawn from - latched
+//  registers, window row, sprite list, and the tile numbers plus tile
+//  generations under the visible BG/window/sprite pixels. When the frame
+//  buffer row already holds a line with the same signature it is left
+//  alone. Lines with mid-line register writes are not signed (0).
+//------------------------------------------------------------------------------
+bool PPU::windowOnLine(const LineRegs& regs) const
+{
+    return (regs.lcdc & 0x21) == 0x21 && currentLine >= regs.wy
+        && int(regs.wx) - 7 < 160;
+}
+
+uint64_t PPU::lineSignature() const
+{
+    if (lineWriteCount != 0) return 0;
+
+    const LineRegs& r = lineRegs;
+    const VRAMGenerations& gen = memory->vramGen;
+    const bool useUnsigned = (r.lcdc & 0x10) != 0;
+    auto tileOf = [&](uint8_t raw) {
+        return useUnsigned ? uint16_t(raw) : uint16_t(256 + int8_t(raw));
+    };
+
+    uint64_t h = hashCombine(0, uint64_t(r.lcdc) | uint64_t(r.scy) << 8
+        | uint64_t(r.scx) << 16 | uint64_t(r.bgp) << 24 | uint64_t(r.obp0) << 32
+        | uint64_t(r.obp1) << 40 | uint64_t(r.wy) << 48 | uint64_t(r.wx) << 56);
+
+    // Background: the 21 map cells under the screen
+    if (r.lcdc & 0x01) {
+        uint16_t map = (r.lcdc & 0x08) ? 0x1C00 : 0x1800;
+        int row = uint8_t(r.scy + currentLine) >> 3;
+        for (int i = 0; i < 21; ++i) {
+            uint16_t tile = tileOf(vram[map + row * 32 + (((r.scx >> 3) + i) & 31)]);
+            h = hashCombine(h, uint64_t(tile) << 32 | gen.tile[tile]);
+        }
+    }
+
+    // Window: the cells of its current row that reach the screen
+    if (windowOnLine(r)) {
+        int wl = std::max(windowLine, 0);
+        uint16_t map = (r.lcdc & 0x40) ? 0x1C00 : 0x1800;
+        int startX = std::max(0, int(r.wx) - 7);
+        int firstCol = (startX - (int(r.wx) - 7)) >> 3;
+        int lastCol = (159 - (int(r.wx) - 7)) >> 3;
+        h = hashCombine(h, uint64_t(wl));
+        for (int col = firstCol; col <= lastCol; ++col) {
+            uint16_t tile = tileOf(vram[map + (wl >> 3) * 32 + col]);
+            h = hashCombine(h, uint64_t(tile) << 32 | gen.tile[tile]);
         }
-        penalty += count * 6;                                     // 0-60 dots
     }
-    return penalty;                                               // 0-73+ dots
+
+    // Sprites (an 8x16 sprite may use either tile of its pair)
+    if (r.lcdc & 0x02) {
+        for (int i = 0; i < lineSpriteCount; ++i) {
+            const SpriteEntry& s = lineSprites[i];
+            h = hashCombine(h, uint64_t(uint16_t(s.x)) | uint64_t(uint16_t(s.y)) << 16
+                | uint64_t(s.tile) << 32 | uint64_t(s.attr) << 40);
+            h = hashCombine(h, gen.tile[s.tile & 0xFE]);
+            h = hashCombine(h, gen.tile[s.tile | 0x01]);
+        }
+    }
+    return h | 1;   // never 0
 }
 
+// Record the line's signature in the frame and say whether the row already
+// sitting in this buffer was drawn from the same inputs.
+bool PPU::keepLine(Frame& frame, int line, uint64_t sig)
+{
+    frame.changedLines[line] = (sig == 0 || sig != lastLineSig[line]);
+    lastLineSig[line] = sig;
 
+    if (sig != 0 && frame.lineSig[line] == sig) return true;
+    frame.lineSig[line] = sig;
+    return false;
+}
 
 void PPU::renderScanline()
 {
-    std::fill(std::begin(scanline), std::end(scanline), 0);
-    // 1.  Render BG into a temporary 160-pixel buffer (color index 0-3).
-    scanlineBackground();
+    const uint64_t sig = lineSignature();
+    if (frameMode == RenderMode::Threaded) {
+        streamLine(sig);   // the render thread makes the keepLine() call
+        return;
+    }
+
+    Frame& frame = frames.back();
+    if (keepLine(frame, currentLine, sig)) {
+        if (windowOnLine(lineRegs)) windowLine = std::max(windowLine, 0) + 1;
+        return;
+    }
+
+    if (frameMode == RenderMode::Parallel) {
+        captureLine();     // drawn at VBlank by rasterizeCaptured()
+        return;
+    }
+
+    LineRegs regs = lineRegs;
+    uint8_t* out = frame.pixels[currentLine];
+    int wl = std::max(windowLine, 0);   // window row shared by every span
+    bool windowDrawn = false;
+
+    // Without mid-line writes this is a single [0, 160) span.
+    int w = 0;
+    for (int x0 = 0; x0 < 160; ) {
+        int x1 = (w < lineWriteCount) ? lineWrites[w].x : 160;
 
-    // 2.  If the window is visible this line, replace the relevant pixels.
-    scanlineWindow();
+        if (x1 > x0) {
+            // 1.  Render BG into a temporary 160-pixel buffer (color index 0-3).
+            scanlineBackground(regs, x0, x1);
 
-    // 3.  Overlay up to 10 sprites, handling priority & transparency.
-    scanlineSprite();
+            // 2.  If the window is visible this span, replace the relevant pixels.
+            windowDrawn |= scanlineWindow(regs, wl, x0, x1);
 
-    // 4.  Convert the 4-level color indices in scanline[]
-    //     to 32-bit RGB and copy into the frame buffer.
-    for (int x = 0; x < 160; ++x)
-        framebuffer[currentLine][x] = mapColor(scanline[x]);
+            // 3.  Overlay up to 10 sprites, handling priority & transparency.
+            scanlineSprite(regs, x0, x1);
+
+            // 4.  Run the tagged colour indices in scanline[] through the
+            //     palettes and store the shades (0-3) in the frame buffer.
+            uint8_t shade[0x40] {};
+            loadShadeTable(regs, shade);
+            for (int x = x0; x < x1; ++x)
+                out[x] = shade[scanline[x] & 0x33];
+        }
+
+        // Apply every write that lands on this boundary
+        while (w < lineWriteCount && lineWrites[w].x == x1)
+            applyRegWrite(regs, lineWrites[w++]);
+        x0 = x1;
+    }
+
+    if (windowDrawn) windowLine = wl + 1;
+}
+
+//------------------------------------------------------------------------------
+//  Parallel rendering. Once a line's registers, mid-line writes and sprites
+//  are latched, the only state carried from one line to the next is the
+//  window line counter, and that only needs the span walk (no pixels). So
+//  the emulation thread records each line plus a VRAM snapshot and advances
+//  the counter itself; at VBlank the pool draws every recorded line into
+//  the back buffer. The rasterizer reads tiles directly rather than through
+//  bgCache, which is single-threaded, but produces the same colour indices.
+//------------------------------------------------------------------------------
+void PPU::setRenderMode(RenderMode mode, unsigned threads)
+{
+#ifdef GB_PIXEL_FIFO
+    (void)mode; (void)threads;     // the FIFO draws while it times mode 3
+#else
+    if (mode == RenderMode::Parallel && !linePool)
+        linePool = std::make_unique<WorkerPool>(
+            threads ? threads : std::thread::hardware_concurrency());
+    if (mode == RenderMode::Threaded && !renderThread.joinable()) {
+        commands = std::make_unique<CommandRing>();
+        renderThread = std::thread([this] { renderThreadLoop(); });
+    }
+    requestedMode = mode;
+#endif
+}
+
+// Frame boundary: the frame buffers change hands between the emulation and
+// render threads only here, with the render thread idle.
+void PPU::switchFrameMode()
+{
+    if (requestedMode == frameMode) return;
+
+    if (frameMode == RenderMode::Threaded) {
+        waitRenderIdle();
+        memory->vramWriteHook = nullptr;
+    }
+    if (requestedMode == RenderMode::Threaded) {
+        std::memcpy(renderVram, vram, sizeof(renderVram));
+        memory->vramWriteHook = [this](uint16_t address, uint8_t value) {
+            pushCommand({ RenderCommand::VramWrite, value, 0, 0, uint32_t(address - 0x8000) });
+        };
+    }
+    frameMode = requestedMode;
+}
+
+void PPU::fillLineState(LineState& ls) const
+{
+    ls.regs = lineRegs;
+    std::copy(lineWrites, lineWrites + lineWriteCount, ls.writes);
+    ls.writeCount = lineWriteCount;
+    std::copy(lineSprites, lineSprites + lineSpriteCount, ls.sprites);
+    ls.spriteCount = lineSpriteCount;
+    ls.windowLine = std::max(windowLine, 0);
+}
+
+void PPU::captureLine()
+{
+    if (snapshotCount == 0 || memory->vramGen.total != snapshotGen) {
+        if (int(vramSnapshots.size()) == snapshotCount)
+            vramSnapshots.emplace_back();
+        std::memcpy(vramSnapshots[snapshotCount++].data(), vram, 0x2000);
+        snapshotGen = memory->vramGen.total;
+    }
+
+    LineState& ls = capturedLines[currentLine];
+    fillLineState(ls);
+    ls.snapshot = snapshotCount - 1;
+    captured.set(currentLine);
+
+    if (windowShown(ls, currentLine)) windowLine = ls.windowLine + 1;
+}
+
+void PPU::rasterizeCaptured()
+{
+    Frame& frame = frames.back();
+    constexpr int BAND = 8;                 // lines per task
+    linePool->run(144 / BAND, [&](int band) {
+        for (int line = band * BAND; line < (band + 1) * BAND; ++line) {
+            if (!captured.test(line)) continue;
+            const LineState& ls = capturedLines[line];
+            rasterizeLine(ls, line, vramSnapshots[ls.snapshot].data(), frame.pixels[line]);
+        }
+    });
+    resetCapture();
+}
+
+// Same span walk and window test as renderScanline()/scanlineWindow().
+bool PPU::windowShown(const LineState& ls, int line)
+{
+    LineRegs regs = ls.regs;
+    int w = 0;
+    for (int x0 = 0; x0 < 160; ) {
+        int x1 = (w < ls.writeCount) ? ls.writes[w].x : 160;
+        if (x1 > x0 && (regs.lcdc & 0x21) == 0x21 && line >= regs.wy
+            && std::max(x0, int(regs.wx) - 7) < x1)
+            return true;
+        while (w < ls.writeCount && ls.writes[w].x == x1)
+            applyRegWrite(regs, ls.writes[w++]);
+        x0 = x1;
+    }
+    return false;
+}
+
+void PPU::rasterizeLine(const LineState& ls, int line, const uint8_t* vram, uint8_t* out)
+{
+    uint8_t scan[160];
+    LineRegs regs = ls.regs;
+
+    // Colour index of BG/window map pixel (mx, my)
+    auto mapPixel = [&](int map, int mx, int my) {
+        uint8_t raw = vram[0x1800 + map * 0x400 + (my >> 3) * 32 + (mx >> 3)];
+        uint16_t tile = (regs.lcdc & 0x10) ? raw : uint16_t(256 + int8_t(raw));
+        const uint8_t* data = vram + tile * 16 + (my & 7) * 2;
+        int bit = 7 - (mx & 7);
+        return uint8_t(((data[1] >> bit) & 1) << 1 | ((data[0] >> bit) & 1));
+    };
+
+    int w = 0;
+    for (int x0 = 0; x0 < 160; ) {
+        int x1 = (w < ls.writeCount) ? ls.writes[w].x : 160;
+
+        if (x1 > x0) {
+            // Background
+            if (regs.lcdc & 0x01) {
+                int map = (regs.lcdc & 0x08) ? 1 : 0;
+                uint8_t bgY = regs.scy + line;
+                for (int x = x0; x < x1; ++x)
+                    scan[x] = mapPixel(map, uint8_t(regs.scx + x), bgY);
+            }
+            else {
+                std::fill(scan + x0, scan + x1, 0);
+            }
+
+            // Window
+            if ((regs.lcdc & 0x21) == 0x21 && line >= regs.wy) {
+                int wx = int(regs.wx) - 7;
+                int map = (regs.lcdc & 0x40) ? 1 : 0;
+                for (int x = std::max(x0, wx); x < x1; ++x)
+                    scan[x] = mapPixel(map, x - wx, uint8_t(ls.windowLine));
+            }
+
+            // Sprites, as scanlineSprite()
+            if (regs.lcdc & 0x02) {
+                const int spriteH = (regs.lcdc & 0x04) ? 16 : 8;
+                for (int i = 0; i < ls.spriteCount; ++i) {
+                    const OAMCache::Sprite& sp = ls.sprites[i];
+                    if (sp.x + 8 <= x0 || sp.x >= x1) continue;
+
+                    int row = line - sp.y;
+                    if (sp.attr & 0x40) row = spriteH - 1 - row;
+                    uint8_t baseTile = sp.tile;
+                    if (spriteH == 16) baseTile &= 0xFE;
+                    if (spriteH == 16 && row >= 8) {
+                        baseTile += 1;
+                        row -= 8;
+                    }
+                    if (row < 0 || row > 7) continue;
+
+                    uint8_t lo = vram[baseTile * 16 + row * 2];
+                    uint8_t hi = vram[baseTile * 16 + row * 2 + 1];
+                    bool xFlip = sp.attr & 0x20;
+                    bool priority = sp.attr & 0x80;
+                    uint8_t palTag = 0x10 | ((sp.attr & 0x10) ? 0x20 : 0x00);
+
+                    for (int px = 0; px < 8; ++px) {
+                        int bit = xFlip ? px : (7 - px);
+                        uint8_t color = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
+                        int screenX = sp.x + px;
+                        if (color == 0 || screenX < x0 || screenX >= x1) continue;
+                        if (priority && (scan[screenX] & 0x03) != 0) continue;
+                        if (scan[screenX] & 0x10) continue;
+                        scan[screenX] = palTag | color;
+                    }
+                }
+            }
+
+            uint8_t shade[0x40] {};
+            loadShadeTable(regs, shade);
+            for (int x = x0; x < x1; ++x)
+                out[x] = shade[scan[x] & 0x33];
+        }
+
+        while (w < ls.writeCount && ls.writes[w].x == x1)
+            applyRegWrite(regs, ls.writes[w++]);
+        x0 = x1;
+    }
+}
+
+//------------------------------------------------------------------------------
+//  Render thread. The emulation thread keeps doing everything that affects
+//  timing (OAM search, mode-3 length, window line counter, signatures) and
+//  sends the render thread only what the pixels need. Sprites go per line
+//  since the OAM search already ran here, so no OAM copy is kept. The ring
+//  is bounded: when it is full the emulation thread waits for the renderer.
+//------------------------------------------------------------------------------
+void PPU::pushCommand(const RenderCommand& cmd)
+{
+    while (!commands->push(cmd)) {
+        renderWake.notify_one();
+        std::this_thread::yield();
+    }
+    ++commandsPushed;
+    if (cmd.op == RenderCommand::FrameEnd)
+        renderWake.notify_one();
+}
+
+void PPU::flushRendering()
+{
+    if (frameMode == RenderMode::Threaded) waitRenderIdle();
+}
+
+void PPU::waitRenderIdle()
+{
+    while (commandsDone.load(std::memory_order_acquire) != commandsPushed) {
+        renderWake.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+void PPU::streamLine(uint64_t sig)
+{
+    LineState ls;
+    fillLineState(ls);
+
+    RenderCommand begin { RenderCommand::LineBegin, uint8_t(currentLine), uint8_t(ls.windowLine) };
+    static_assert(sizeof(LineRegs) <= sizeof(begin.data), "LineRegs must fit a command");
+    std::memcpy(&begin.data, &ls.regs, sizeof(LineRegs));
+    pushCommand(begin);
+
+    for (int i = 0; i < ls.spriteCount; ++i) {
+        RenderCommand sprite { RenderCommand::Sprite };
+        static_assert(sizeof(OAMCache::Sprite) <= sizeof(sprite.data), "Sprite must fit a command");
+        std::memcpy(&sprite.data, &ls.sprites[i], sizeof(OAMCache::Sprite));
+        pushCommand(sprite);
+    }
+    for (int i = 0; i < ls.writeCount; ++i)
+        pushCommand({ RenderCommand::RegWrite, ls.writes[i].x, ls.writes[i].reg, ls.writes[i].value });
+
+    pushCommand({ RenderCommand::LineEnd, 0, 0, 0, 0, sig });
+
+    if (windowShown(ls, currentLine)) windowLine = ls.windowLine + 1;
+}
+
+void PPU::renderThreadLoop()
+{
+    LineState ls {};
+    int line = 0;
+    int idleSpins = 0;
+    RenderCommand cmd;
+
+    while (!renderQuit.load(std::memory_order_relaxed)) {
+        if (!commands->pop(cmd)) {
+            // Spin briefly (more of the line is usually on its way), then
+            // sleep until the next frame or a full ring wakes us
+            if (++idleSpins < 64) {
+                std::this_thread::yield();
+            }
+            else {
+                std::unique_lock<std::mutex> lock(renderMutex);
+                renderWake.wait_for(lock, std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+        idleSpins = 0;
+
+        switch (cmd.op) {
+        case RenderCommand::LineBegin:
+            line = cmd.a;
+            ls.windowLine = cmd.b;
+            std::memcpy(&ls.regs, &cmd.data, sizeof(LineRegs));
+            ls.spriteCount = 0;
+            ls.writeCount = 0;
+            break;
+        case RenderCommand::Sprite:
+            std::memcpy(&ls.sprites[ls.spriteCount++], &cmd.data, sizeof(OAMCache::Sprite));
+            break;
+        case RenderCommand::RegWrite:
+            ls.writes[ls.writeCount++] = { cmd.a, cmd.b, cmd.c };
+            break;
+        case RenderCommand::VramWrite:
+            renderVram[cmd.offset] = cmd.a;
+            break;
+        case RenderCommand::LineEnd: {
+            Frame& frame = frames.back();
+            if (!keepLine(frame, line, cmd.data))
+                rasterizeLine(ls, line, renderVram, frame.pixels[line]);
+            break;
+        }
+        case RenderCommand::FrameEnd:
+            frames.publish();
+            frameReady = true;
+            break;
+        case RenderCommand::LcdOff:
+            publishBlankFrame();
+            break;
+        }
+        commandsDone.fetch_add(1, std::memory_order_release);
+    }
 }
 
 void PPU::step(int ticks) {
+    // LCD off: LY stays 0 in mode 0, nothing is drawn or requested
+    if (!(memory->read(0xFF40) & 0x80)) {
+        if (lcdOn) lcdTurnedOff();
+        return;
+    }
+    if (!lcdOn) lcdTurnedOn();
+
     modeClock += ticks;
 
     switch (mode) {
     case OAM_SEARCH:  // Mode 2
-        if (modeClock >= 80) enterMode(DRAWING, modeClock - 80);
+        if (modeClock >= 80) {
+            oamSearch();
+#ifdef GB_PIXEL_FIFO
+            fifo.start(vram, memory->io_registers, currentLine, std::max(windowLine, 0),
+                       lineSprites, lineSpriteCount,
+                       renderingFrame ? frames.back().pixels[currentLine] : scratchRow);
+            fifoDots = 0;
+            frames.back().lineSig[currentLine] = 0;     // FIFO lines are never skipped
+            frames.back().changedLines.set(currentLine);
+#else
+            latchLineRegs();
+            // Duration is 172 + SCX%8 + sprite/window penalties
+            lastM3Length = 172 + calculateDrawPenalties();
+#endif
+            enterMode(DRAWING, modeClock - 80);
+        }
         break;
 
     case DRAWING:     // Mode 3
-        // Duration is 172 + SCX%8 + sprite/window penalties
-        lastM3Length = 172 + calculateDrawPenalties() ;
+#ifdef GB_PIXEL_FIFO
+        // Lasts exactly as long as the FIFO needs to push 160 pixels
+        fifoDots += fifo.run(modeClock - fifoDots);
+        if (fifo.done()) {
+            lastM3Length = fifoDots;
+            if (fifo.windowUsed()) windowLine = std::max(windowLine, 0) + 1;
+            enterMode(HBLANK, modeClock - lastM3Length);
+        }
+#else
         if (modeClock >= lastM3Length) {
 
-            renderScanline(); // draw pixels here
+            if (renderingFrame)
+                renderScanline(); // draw pixels here
             enterMode(HBLANK, modeClock - lastM3Length);
         }
+#endif
         break;
 
     case HBLANK: {      // Mode 0
@@ -138,6 +712,7 @@ void PPU::step(int ticks) {
             if (currentLine > 153) {
                 currentLine = 0;
 				windowLine = -1;  // reset window line
+                beginFrame();
                 memory->write(0xFF44, 0);
                 checkCoincidence();                 // update bit-2, maybe raise IRQ
                 enterMode(OAM_SEARCH, modeClock);
@@ -157,172 +732,68 @@ void PPU::step(int ticks) {
     }
 }
 
-void PPU::scanlineBackground()
+void PPU::scanlineBackground(const LineRegs& regs, int x0, int x1)
 {
-
-    uint8_t lcdc = memory->read(0xFF40);
-    bool bgEnabled = lcdc & 0x01;
-        
-    bool useUnsigned = (lcdc & 0x10) != 0;
-    uint16_t mapBase = (lcdc & 0x08) ? 0x9C00 : 0x9800;
-
-    uint8_t scy = memory->read(0xFF42);
-    uint8_t scx = memory->read(0xFF43);
-    uint8_t ly = currentLine;
-
+    bool bgEnabled = regs.lcdc & 0x01;
+    bool useUnsigned = (regs.lcdc & 0x10) != 0;
+    int map = (regs.lcdc & 0x08) ? 1 : 0;      // 0x9C00 : 0x9800
 
     if (!bgEnabled) {
-        std::fill(std::begin(scanline), std::end(scanline), 0);  // colour 0
+        std::fill(scanline + x0, scanline + x1, 0);  // colour 0
         return;
     }
 
-    uint8_t bgY = scy + ly;
-    uint8_t pixelRow = bgY & 0x07;  // which of the 8 Y rows
-
-    for (int x = 0; x < 160; ++x) {
-        uint8_t bgX = scx + x;
-        
-
-        uint16_t tileRow = bgY >> 3;
-        uint16_t tileCol = bgX >> 3;
-
-        // correct pixel within tile values:
-        uint8_t pixelCol = bgX & 0x07;  // which of the 8 bits in that row
-
-        uint16_t tileMapAddr = mapBase + tileRow * 32 + tileCol;
-
-        uint8_t raw = vram[tileMapAddr - 0x8000];
-        int16_t index16 = useUnsigned ? raw : int8_t(raw);
-        uint16_t tileAddr = (useUnsigned ? 0x8000 : 0x9000) + index16 * 16;
-
-        // pick the two data bytes for this row
-        uint8_t lo = vram[tileAddr + pixelRow * 2 - 0x8000];
-        uint8_t hi = vram[tileAddr + pixelRow * 2 + 1 - 0x8000];
-		
-
-        // extract the correct bit for this column
-        int bit = 7 - pixelCol;
-        uint8_t colour = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
-
-        scanline[x] = colour;
-    }
+    // The cached 256-pixel map row wraps horizontally: copy it in two parts.
+    uint8_t bgY = regs.scy + currentLine;
+    uint8_t bgX = regs.scx + x0;
+    int width = x1 - x0;
+    const uint8_t* row = bgCache.row(vram, memory->vramGen, map, bgY,
+                                     useUnsigned, bgX, width);
 
+    int first = std::min(width, 256 - bgX);
+    std::memcpy(scanline + x0, row + bgX, first);
+    std::memcpy(scanline + x0 + first, row, width - first);
 }
 
 
 
-//
+// Returns true if any window pixel was drawn in [x0, x1).
+bool PPU::scanlineWindow(const LineRegs& regs, int winLine, int x0, int x1) {
+    // Window disabled or BG/window off
+    if (!(regs.lcdc & 0x20) || !(regs.lcdc & 0x01)) return false;
 
-void PPU::scanlineWindow() {
-    constexpr int SCREEN_W = 160;
-    constexpr int TILE_W = 8;
-    constexpr int MAP_TILES = 32;
-    constexpr int MAP_MASK = MAP_TILES - 1;
+    int wx = int(regs.wx) - 7;                 // screen X offset
 
-    uint8_t lcdc = memory->read(0xFF40);
-    // Window disabled or LCD off
-    if (!(lcdc & 0x20) || !(lcdc & 0x01)) return;
-
-    int wy = memory->read(0xFF4A);
-    int wx = int(memory->read(0xFF4B)) - 7;    // screen X offset
-
-    // Not yet reached the window vertically, or fully off right
-    if (currentLine < wy || wx >= SCREEN_W) return;
-
-    // Start windowLine on first visible line
-    if (windowLine == -1) windowLine = 0;
-
-    // Invariants for this scanline
-    int tileRow = windowLine / TILE_W;               // which tilerow
-    int pixRow = windowLine % TILE_W;               // which Ypixel in that tile
-    int rowByte = pixRow * 2;                        // byteoffset in tile data
-    bool useUnsigned = (lcdc & 0x10) != 0;             // tiledata signed/unsigned
-    uint16_t mapBase = (lcdc & 0x40) ? 0x9C00 : 0x9800;// window map select
-
-    // Compute range in screen X
-    int startX = std::max(0, wx);
-    int endX = SCREEN_W - 1;
-
-    // First and last tile indices (modulo 32 for wrap)
-    int firstTileX = ((startX - wx) / TILE_W) & MAP_MASK;
-    int lastTileX = ((endX - wx) / TILE_W) & MAP_MASK;
-    int numTiles = lastTileX - firstTileX + 1;
-    if (numTiles < 0) numTiles += MAP_TILES;
-
-    // Pixel offset into the first tile
-    int firstOffset = (startX - wx) % TILE_W;
-    if (firstOffset < 0) firstOffset += TILE_W;
-
-    // Now batch pertile
-    for (int t = 0; t < numTiles; ++t) {
-        int tileCol = (firstTileX + t) & MAP_MASK;
-        // 1) Fetch tile index once
-        uint16_t mapAddr = mapBase + tileRow * MAP_TILES + tileCol;
-        uint8_t  raw = memory->read(mapAddr);
-        int16_t  idx = useUnsigned ? raw : int8_t(raw);
-
-        // 2) Fetch the two data bytes once
-        uint16_t tileAddr = (useUnsigned ? 0x8000 : 0x9000) + idx * 16;
-        uint8_t  loRow = memory->read(tileAddr + rowByte);
-        uint8_t  hiRow = memory->read(tileAddr + rowByte + 1);
-
-        // 3) Unpack the pixels
-        int tileScreenX = (t * TILE_W) + wx;  // leftedge in screen coords
-        int pxStart = (t == 0 ? firstOffset : 0);
-        int pxEnd = (t == numTiles - 1)
-            ? ((endX - wx) % TILE_W)
-            : (TILE_W - 1);
-
-        for (int px = pxStart; px <= pxEnd; ++px) {
-            int screenX = tileScreenX + px;
-            if (screenX < 0 || screenX > endX) continue;
-
-            // absolute bit index within tile data
-            int bit = 7 - px;
-            uint8_t colour = ((hiRow >> bit) & 1) << 1
-                | ((loRow >> bit) & 1);
-            scanline[screenX] = colour;
-        }
-    }
+    // Not yet reached the window vertically, or not inside this span
+    if (currentLine < regs.wy) return false;
+    int startX = std::max(x0, wx);
+    if (startX >= x1) return false;
+
+    bool useUnsigned = (regs.lcdc & 0x10) != 0;        // tiledata signed/unsigned
+    int map = (regs.lcdc & 0x40) ? 1 : 0;              // window map select
 
-    windowLine++;
+    // Window X never exceeds 167 pixels, so the map row needs no wrapping
+    int winX = startX - wx;
+    int width = x1 - startX;
+    const uint8_t* row = bgCache.row(vram, memory->vramGen, map,
+                                     uint8_t(winLine), useUnsigned,
+                                     uint8_t(winX), width);
+    std::memcpy(scanline + startX, row + winX, width);
+    return true;
 }
 
 
-void PPU::scanlineSprite() {
-    uint8_t lcdc = memory->read(0xFF40);
-    if (!(lcdc & 0x02)) return;  // Sprites off
-
-    const int spriteH = spriteHeight();  // 8 or 16
-    struct OAMEntry { int16_t x, y; uint8_t tile, attr; };
-    OAMEntry candidates[10];
-    int nSprites = 0;
-
-    // 1) Collect up to 10 sprites that overlap this line
-    for (int i = 0; i < 40 && nSprites < 10; ++i) {
-        int16_t sprY = int16_t(memory->read(0xFE00 + i * 4)) - 16;
-        int16_t sprX = int16_t(memory->read(0xFE00 + i * 4 + 1)) - 8;
-        if (currentLine >= sprY && currentLine < sprY + spriteH) {
-            candidates[nSprites++] = {
-                sprX,
-                sprY,
-                memory->read(0xFE00 + i * 4 + 2),
-                memory->read(0xFE00 + i * 4 + 3)
-            };
-        }
-    }
+void PPU::scanlineSprite(const LineRegs& regs, int x0, int x1) {
+    if (!(regs.lcdc & 0x02)) return;  // Sprites off
 
-    // 2) Sort by X (lower X first; ties keep OAM order)
-    std::sort(candidates, candidates + nSprites,
-        [](auto& a, auto& b) { return a.x < b.x; }
-    );
+    const int spriteH = (regs.lcdc & 0x04) ? 16 : 8;
 
-    // 3) Render each sprite
-    for (int i = 0; i < nSprites; ++i) {
-        auto& sp = candidates[i];
+    // Render each sprite picked by the mode-2 search (already X-sorted)
+    for (int i = 0; i < lineSpriteCount; ++i) {
+        auto& sp = lineSprites[i];
 
-        // Skip fully off screen
-        if (sp.x <= -8 || sp.x >= 160) continue;
+        // Skip sprites entirely outside this span
+        if (sp.x + 8 <= x0 || sp.x >= x1) continue;
 
         // Determine which row of the sprite to draw
         int row = currentLine - sp.y;
@@ -336,11 +807,12 @@ void PPU::scanlineSprite() {
             baseTile += 1;
             row -= 8;
         }
+        if (row < 0 || row > 7) continue;  // OBJ size shrank since mode 2
 
         // Fetch that tile's two bytes just once
-        uint16_t tileAddr = 0x8000 + baseTile * 16;
-        uint8_t lo = memory->read(tileAddr + row * 2);
-        uint8_t hi = memory->read(tileAddr + row * 2 + 1);
+        const uint8_t* tile = vram + baseTile * 16;
+        uint8_t lo = tile[row * 2];
+        uint8_t hi = tile[row * 2 + 1];
 
         bool xFlip = sp.attr & 0x20;
         bool priority = sp.attr & 0x80;      // OBJ to BG priority
@@ -354,7 +826,7 @@ void PPU::scanlineSprite() {
             if (color == 0) continue;  // transparent
 
             int screenX = sp.x + px;
-            if (screenX < 0 || screenX >= 160) continue;
+            if (screenX < x0 || screenX >= x1) continue;
 
             // If BG priority bit set *and* BG pixel non-zero, skip
             if (priority && (scanline[screenX] & 0x03) != 0)
@@ -441,8 +913,17 @@ void PPU::enterMode(uint8_t newMode, int carry)
     case VBLANK:           // Mode 1
         
         memory->requestInterrupt(Memory::INT_VBLANK);  // IF bit-0
-        if (newMode == VBLANK && currentLine == 144)
-            frameReady = true;
+        if (newMode == VBLANK && currentLine == 144 && renderingFrame) {
+            if (frameMode == RenderMode::Parallel)
+                rasterizeCaptured();
+            if (frameMode == RenderMode::Threaded) {
+                pushCommand({ RenderCommand::FrameEnd });
+            }
+            else {
+                frames.publish();
+                frameReady = true;
+            }
+        }
         if (stat & 0x10)   // STAT bit 4 = "Mode-1 interrupt enable"
             requestSTAT();
         break;
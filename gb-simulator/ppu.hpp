@@ -1,7 +1,23 @@
 #pragma once 
 
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bgcache.hpp"
+#include "frame.hpp"
+#include "oamcache.hpp"
+#include "spsc.hpp"
+#include "workerpool.hpp"
+#ifdef GB_PIXEL_FIFO
+#include "pixelfifo.hpp"
+#endif
 
 class Memory; // Forward declaration of Memory class
 
@@ -9,30 +25,48 @@ class Memory; // Forward declaration of Memory class
 class PPU {
 public:
 
-    PPU() {
-        for (int i = 0; i < 144; ++i) {
-            for (int j = 0; j < 160; ++j) {
-                framebuffer[i][j] = 0xFFFFFFFF; // Initialize all pixels to white
-            }
-		}
-    };
+    PPU() {};
+    ~PPU();
 
     void connectVRAM(uint8_t* vramPtr) { vram = vramPtr; }
     void connectOAM(uint8_t* oamPtr) { oam = oamPtr; }
     void connectIO(uint8_t* ioRegsPtr) { io = ioRegsPtr; }
 
-	void connectMemory(Memory* memoryPtr) { memory = memoryPtr; }
+	void connectMemory(Memory* memoryPtr);
     void reset();
     void step(int ticks);
 
 
 
-    const uint32_t* framebufferData() const {
-        return  &framebuffer[0][0];         // decays to &framebuffer[0]
-    }
-    bool takeFrameReady() { bool f = frameReady; frameReady = false; return f; }
+    // Completed frames (one shade per pixel, see pixelconv.hpp) are published
+    // here at VBlank. The consumer may live on another thread.
+    FrameMailbox& frameMailbox() { return frames; }
+    bool takeFrameReady() { return frameReady.exchange(false); }
+
+    // Called by Memory for every write to 0xFF40-0xFF4B.
+    void registerWritten(uint16_t address, uint8_t value);
+
+    // Frame skipping only drops pixel work: modes, LY, STAT, interrupts and
+    // mode-3 lengths are identical whatever the setting.
+    void setFrameSkip(int n) { frameSkip = n < 1 ? 1 : n; }  // draw 1 of n frames
+    void setRenderOnRequest(bool on) { renderOnRequest = on; }
+    void requestFrame() { frameRequested = true; }          // draw the next frame
+
+    // Where pixels get drawn. Frames, signatures and timing are identical in
+    // every mode.
+    //  Inline   - each line is drawn when its mode 3 ends (default)
+    //  Parallel - lines are only recorded during the frame, and a worker
+    //             pool rasterizes all of them at VBlank
+    //  Threaded - line starts, register writes and VRAM deltas are streamed
+    //             to a render thread that keeps its own VRAM copy and draws
+    // Takes effect from the next frame. threads = 0 picks
+    // hardware_concurrency (Parallel only).
+    enum class RenderMode { Inline, Parallel, Threaded };
+    void setRenderMode(RenderMode mode, unsigned threads = 0);
+    // Wait until the render thread has drawn everything emitted so far,
+    // e.g. before reading the frame a test just ran to.
+    void flushRendering();
 
-    uint32_t framebuffer[144][160];
 private:
     enum IOReg : uint8_t {
         LCDC = 0x40,
@@ -44,16 +78,103 @@ private:
         DMA = 0x46,
         BGP = 0x47,
         OBP0 = 0x48,
-        OBP1 = 0x49
+        OBP1 = 0x49,
+        WY = 0x4A,
+        WX = 0x4B
     };
     int windowLine = -1;   // -1 means window not started yet this frame
 
-    bool frameReady = false;
+    // Pixel-pipeline registers latched when mode 3 starts, plus the writes
+    // made to them during mode 3 (X-ordered). See registerWritten().
+    struct LineRegs { uint8_t lcdc, scy, scx, bgp, obp0, obp1, wy, wx; };
+    struct RegWrite { uint8_t x, reg, value; };   // reg = IOReg offset
+    static constexpr int MAX_LINE_WRITES = 32;
+    LineRegs lineRegs {};
+    RegWrite lineWrites[MAX_LINE_WRITES] {};
+    int lineWriteCount = 0;
+    void latchLineRegs();
+    static void applyRegWrite(LineRegs& regs, const RegWrite& w);
+
+    std::atomic<bool> frameReady { false };
+    uint64_t lastLineSig[144] {};   // signatures of the last drawn frame
+    FrameMailbox frames;     // PPU draws into frames.back()
+
+    int frameSkip = 1;
+    bool renderOnRequest = false;
+    bool frameRequested = false;
+    unsigned frameCounter = 0;
+    bool renderingFrame = true;  // decided once per frame in beginFrame()
      // Framebuffer for 144 lines of 160 pixels each
 
     uint8_t scanline[160] {};
+    BgMapCache bgCache;      // pre-rendered BG/window maps, see bgcache.hpp
 	void checkCoincidence(); // Check LY == LYC and update STAT register
     int lastM3Length = 172;
+#ifdef GB_PIXEL_FIFO
+    PixelFifo fifo;          // accurate mode 3; its length replaces the penalties
+    int fifoDots = 0;
+    uint8_t scratchRow[160] {};
+#endif
+    bool lcdOn = true;       // LCDC bit 7 as last seen by step()
+
+    RenderMode requestedMode = RenderMode::Inline;
+    RenderMode frameMode = RenderMode::Inline;   // decided once per frame in beginFrame()
+    void switchFrameMode();
+    bool keepLine(Frame& frame, int line, uint64_t sig);
+    void publishBlankFrame();
+
+    // --- Parallel rendering (RenderMode::Parallel) ---
+    // Everything a line is drawn from, captured when its mode 3 ends. VRAM
+    // is shared between lines through snapshots, a new one being taken only
+    // when VRAMGenerations::total moved since the last.
+    struct LineState {
+        LineRegs regs;
+        RegWrite writes[MAX_LINE_WRITES];
+        int writeCount;
+        OAMCache::Sprite sprites[10];
+        int spriteCount;
+        int windowLine;      // window row this line draws, if it shows
+        int snapshot;        // index into vramSnapshots
+    };
+    std::unique_ptr<WorkerPool> linePool;
+    LineState capturedLines[144] {};
+    std::bitset<144> captured;
+    std::vector<std::array<uint8_t, 0x2000>> vramSnapshots;
+    int snapshotCount = 0;
+    uint32_t snapshotGen = 0;
+    void fillLineState(LineState& ls) const;
+    void captureLine();
+    void rasterizeCaptured();
+    void resetCapture() { captured.reset(); snapshotCount = 0; }
+    static bool windowShown(const LineState& ls, int line);
+    static void rasterizeLine(const LineState& ls, int line, const uint8_t* vram, uint8_t* out);
+
+    // --- Render thread (RenderMode::Threaded) ---
+    // A line arrives as LineBegin, its sprites and mid-line writes, then
+    // LineEnd; VRAM writes are interleaved in program order, so the render
+    // thread's copy matches VRAM at the moment the line was emitted.
+    struct RenderCommand {
+        enum Op : uint8_t { LineBegin, Sprite, RegWrite, VramWrite, LineEnd, FrameEnd, LcdOff };
+        Op op;
+        uint8_t a {}, b {}, c {};   // LineBegin: line, window line
+                                    // RegWrite: x, reg, value   VramWrite: value
+        uint32_t offset {};         // VramWrite: offset from 0x8000
+        uint64_t data {};           // LineBegin: LineRegs  Sprite: OAMCache::Sprite
+                                    // LineEnd: line signature
+    };
+    using CommandRing = SpscRing<RenderCommand, 8192>;
+    std::unique_ptr<CommandRing> commands;
+    uint64_t commandsPushed = 0;              // emulation thread only
+    std::atomic<uint64_t> commandsDone { 0 };
+    std::thread renderThread;
+    std::atomic<bool> renderQuit { false };
+    std::mutex renderMutex;
+    std::condition_variable renderWake;
+    uint8_t renderVram[0x2000] {};            // owned by the render thread
+    void pushCommand(const RenderCommand& cmd);
+    void streamLine(uint64_t sig);
+    void waitRenderIdle();
+    void renderThreadLoop();
 
     // --- Pointers into main memory regions (no full Memory*) ---
     uint8_t* vram = nullptr;  // 0x80000x9FFF
@@ -76,18 +197,28 @@ private:
 
     uint8_t mode = OAM_SEARCH;
 
+    // Sprites selected by the mode-2 OAM search for the current line.
+    // X-sorted; sprites with equal X keep their OAM order.
+    using SpriteEntry = OAMCache::Sprite;
+    SpriteEntry lineSprites[10] {};
+    int lineSpriteCount = 0;
 
-
+    void lcdTurnedOff();
+    void lcdTurnedOn();
+    void beginFrame();
+    void oamSearch();
     int calculateDrawPenalties() const;
 	void renderScanline();
-	void scanlineBackground();
-	void scanlineSprite();
-	void scanlineWindow();
+	uint64_t lineSignature() const;
+	bool windowOnLine(const LineRegs& regs) const;
+	void scanlineBackground(const LineRegs& regs, int x0, int x1);
+	void scanlineSprite(const LineRegs& regs, int x0, int x1);
+	bool scanlineWindow(const LineRegs& regs, int winLine, int x0, int x1);
     int spriteHeight() const;
     bool inOAMRestrictedMode() const;
 
 
-    uint32_t mapColor(uint8_t pix) const;
+    static void loadShadeTable(const LineRegs& regs, uint8_t table[0x40]);
     void enterMode(uint8_t newMode, int carry);
 };
 
@@ -0,0 +1,357 @@
+#include "scaler.hpp"
+#include "pixelconv.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GB_SCALER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+namespace {
+
+constexpr int SRC_W = 160;
+constexpr int SRC_H = 144;
+
+// Copy a w x h shade image into dst with a `border`-pixel replicated edge.
+// Rows of dst are (w + 2 * border + 16) wide so 16-byte loads past the
+// last pixel stay inside the buffer.
+int padImage(const uint8_t* src, int w, int h, int srcPitch, int border, std::vector<uint8_t>& dst)
+{
+    const int pitch = w + 2 * border + 16;
+    dst.resize(size_t(pitch) * (h + 2 * border));
+    for (int y = -border; y < h + border; ++y) {
+        const uint8_t* s = src + std::clamp(y, 0, h - 1) * srcPitch;
+        uint8_t* d = dst.data() + (y + border) * pitch;
+        std::memset(d, s[0], border);
+        std::memcpy(d + border, s, w);
+        std::memset(d + border + w, s[w - 1], pitch - border - w);
+    }
+    return pitch;
+}
+
+// ---- Nearest neighbour --------------------------------------------------
+
+void nearestRows(const uint8_t* src, int srcPitch, int k, uint8_t* dst, int y0, int y1)
+{
+    const int dstW = SRC_W * k;
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t* s = src + y * srcPitch;
+        uint8_t* d = dst + size_t(y * k) * dstW;
+        int x = 0;
+#ifdef GB_SCALER_SSE2
+        if (k == 2 || k == 4) {
+            for (; x + 16 <= SRC_W; x += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+                __m128i lo = _mm_unpacklo_epi8(v, v), hi = _mm_unpackhi_epi8(v, v);
+                if (k == 2) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 2), lo);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 2 + 16), hi);
+                }
+                else {
+                    __m128i q[4] = { _mm_unpacklo_epi8(lo, lo), _mm_unpackhi_epi8(lo, lo),
+                                     _mm_unpacklo_epi8(hi, hi), _mm_unpackhi_epi8(hi, hi) };
+                    for (int i = 0; i < 4; ++i)
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x * 4 + i * 16), q[i]);
+                }
+            }
+        }
+#endif
+        for (; x < SRC_W; ++x)
+            std::memset(d + x * k, s[x], k);
+        for (int r = 1; r < k; ++r)
+            std::memcpy(d + r * dstW, d, dstW);
+    }
+}
+
+// ---- Scale2x ------------------------------------------------------------
+//   A B C      E0 E1
+//   D E F  ->  E2 E3
+//   G H I
+// `src` points at pixel (0, 0) of a padded image.
+
+void scale2xRows(const uint8_t* src, int pitch, int w, uint8_t* dst, int y0, int y1)
+{
+    const int dstW = w * 2;
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t* row = src + y * pitch;
+        uint8_t* d0 = dst + size_t(y * 2) * dstW;
+        uint8_t* d1 = d0 + dstW;
+        int x = 0;
+#ifdef GB_SCALER_SSE2
+        auto load = [](const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+        auto pick = [](__m128i m, __m128i a, __m128i b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); };
+        for (; x + 16 <= w; x += 16) {
+            __m128i B = load(row - pitch + x), H = load(row + pitch + x);
+            __m128i D = load(row + x - 1), E = load(row + x), F = load(row + x + 1);
+            __m128i DB = _mm_cmpeq_epi8(D, B), BF = _mm_cmpeq_epi8(B, F);
+            __m128i DH = _mm_cmpeq_epi8(D, H), HF = _mm_cmpeq_epi8(H, F);
+            // E0: D==B && B!=F && D!=H   E1: B==F && B!=D && F!=H
+            // E2: D==H && D!=B && H!=F   E3: H==F && D!=H && B!=F
+            __m128i c0 = _mm_andnot_si128(_mm_or_si128(BF, DH), DB);
+            __m128i c1 = _mm_andnot_si128(_mm_or_si128(DB, HF), BF);
+            __m128i c2 = _mm_andnot_si128(_mm_or_si128(DB, HF), DH);
+            __m128i c3 = _mm_andnot_si128(_mm_or_si128(DH, BF), HF);
+            __m128i e0 = pick(c0, D, E), e1 = pick(c1, F, E);
+            __m128i e2 = pick(c2, D, E), e3 = pick(c3, F, E);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d0 + x * 2), _mm_unpacklo_epi8(e0, e1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d0 + x * 2 + 16), _mm_unpackhi_epi8(e0, e1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d1 + x * 2), _mm_unpacklo_epi8(e2, e3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d1 + x * 2 + 16), _mm_unpackhi_epi8(e2, e3));
+        }
+#endif
+        for (; x < w; ++x) {
+            uint8_t B = row[x - pitch], H = row[x + pitch];
+            uint8_t D = row[x - 1], E = row[x], F = row[x + 1];
+            d0[x * 2]     = (D == B && B != F && D != H) ? D : E;
+            d0[x * 2 + 1] = (B == F && B != D && F != H) ? F : E;
+            d1[x * 2]     = (D == H && D != B && H != F) ? D : E;
+            d1[x * 2 + 1] = (H == F && D != H && B != F) ? F : E;
+        }
+    }
+}
+
+// ---- Scale3x (AdvMAME3x) ------------------------------------------------
+// The SSE2 kernel covers whole rows; the scalar loop is the fallback.
+static_assert(SRC_W % 16 == 0, "Scale3x SSE2 kernel has no tail loop");
+
+void scale3xRows(const uint8_t* src, int pitch, uint8_t* dst, int y0, int y1)
+{
+    const int dstW = SRC_W * 3;
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t* row = src + y * pitch;
+        uint8_t* d0 = dst + size_t(y * 3) * dstW;
+        uint8_t* d1 = d0 + dstW;
+        uint8_t* d2 = d1 + dstW;
+        int x = 0;
+#ifdef GB_SCALER_SSE2
+        auto load = [](const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+        auto pick = [](__m128i m, __m128i a, __m128i b) { return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)); };
+        for (; x + 16 <= SRC_W; x += 16) {
+            __m128i A = load(row - pitch + x - 1), B = load(row - pitch + x), C = load(row - pitch + x + 1);
+            __m128i D = load(row + x - 1),         E = load(row + x),         F = load(row + x + 1);
+            __m128i G = load(row + pitch + x - 1), H = load(row + pitch + x), I = load(row + pitch + x + 1);
+            // on: B!=H && D!=F; every rule below also needs it
+            __m128i on = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(B, H), _mm_cmpeq_epi8(D, F)), _mm_set1_epi8(-1));
+            __m128i DB = _mm_and_si128(on, _mm_cmpeq_epi8(D, B)), BF = _mm_and_si128(on, _mm_cmpeq_epi8(B, F));
+            __m128i DH = _mm_and_si128(on, _mm_cmpeq_epi8(D, H)), HF = _mm_and_si128(on, _mm_cmpeq_epi8(H, F));
+            __m128i EA = _mm_cmpeq_epi8(E, A), EC = _mm_cmpeq_epi8(E, C);
+            __m128i EG = _mm_cmpeq_epi8(E, G), EI = _mm_cmpeq_epi8(E, I);
+            __m128i e[9] = {
+                pick(DB, D, E),
+                pick(_mm_or_si128(_mm_andnot_si128(EC, DB), _mm_andnot_si128(EA, BF)), B, E),
+                pick(BF, F, E),
+                pick(_mm_or_si128(_mm_andnot_si128(EG, DB), _mm_andnot_si128(EA, DH)), D, E),
+                E,
+                pick(_mm_or_si128(_mm_andnot_si128(EI, BF), _mm_andnot_si128(EC, HF)), F, E),
+                pick(DH, D, E),
+                pick(_mm_or_si128(_mm_andnot_si128(EI, DH), _mm_andnot_si128(EG, HF)), H, E),
+                pick(HF, F, E),
+            };
+            // SSE2 has no byte shuffle for a 3-way interleave; spread through memory
+            alignas(16) uint8_t t[9][16];
+            for (int i = 0; i < 9; ++i)
+                _mm_store_si128(reinterpret_cast<__m128i*>(t[i]), e[i]);
+            for (int i = 0; i < 16; ++i) {
+                uint8_t* o0 = d0 + (x + i) * 3;
+                uint8_t* o1 = d1 + (x + i) * 3;
+                uint8_t* o2 = d2 + (x + i) * 3;
+                o0[0] = t[0][i]; o0[1] = t[1][i]; o0[2] = t[2][i];
+                o1[0] = t[3][i]; o1[1] = t[4][i]; o1[2] = t[5][i];
+                o2[0] = t[6][i]; o2[1] = t[7][i]; o2[2] = t[8][i];
+            }
+        }
+#else
+        for (; x < SRC_W; ++x) {
+            uint8_t A = row[x - pitch - 1], B = row[x - pitch], C = row[x - pitch + 1];
+            uint8_t D = row[x - 1],         E = row[x],         F = row[x + 1];
+            uint8_t G = row[x + pitch - 1], H = row[x + pitch], I = row[x + pitch + 1];
+            uint8_t* o0 = d0 + x * 3;
+            uint8_t* o1 = d1 + x * 3;
+            uint8_t* o2 = d2 + x * 3;
+            if (B != H && D != F) {
+                o0[0] = D == B ? D : E;
+                o0[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+                o0[2] = B == F ? F : E;
+                o1[0] = (D == B && E != G) || (D == H && E != A) ? D : E;
+                o1[1] = E;
+                o1[2] = (B == F && E != I) || (H == F && E != C) ? F : E;
+                o2[0] = D == H ? D : E;
+                o2[1] = (D == H && E != I) || (H == F && E != G) ? H : E;
+                o2[2] = H == F ? F : E;
+            }
+            else {
+                std::memset(o0, E, 3);
+                std::memset(o1, E, 3);
+                std::memset(o2, E, 3);
+            }
+        }
+#endif
+    }
+}
+
+// ---- xBR-style 2x -------------------------------------------------------
+// Per output corner, compare the weighted edge strength along the two
+// diagonals of a 5x5 neighbourhood (as xBR does) and, where an edge runs
+// across the corner, take the closer of the two neighbouring shades. Shades
+// are luminance levels already, so |a - b| is the colour distance; there is
+// no blending because the output stays a palette index.
+//
+// Left scalar: a 2000-frame average of lastMs() on one x86-64 thread is
+// 1.4-2.2 ms per frame (Scale3x and nearest 3x, which are bound by the ARGB
+// conversion, take 0.2-0.3 ms), so about a tenth of a 59.7 Hz frame before
+// runBands() splits it across the pool. A vector version would need the
+// 11-tap sums widened to 16 bits.
+
+inline int dist(uint8_t a, uint8_t b) { return std::abs(int(a) - int(b)); }
+
+void xbr2xRows(const uint8_t* src, int pitch, uint8_t* dst, int y0, int y1)
+{
+    const int dstW = SRC_W * 2;
+    for (int y = y0; y < y1; ++y) {
+        const uint8_t* row = src + y * pitch;
+        uint8_t* d0 = dst + size_t(y * 2) * dstW;
+        uint8_t* d1 = d0 + dstW;
+        for (int x = 0; x < SRC_W; ++x) {
+            auto P = [&](int dx, int dy) { return row[x + dx + dy * pitch]; };
+            const uint8_t E = P(0, 0);
+            uint8_t out[4];
+            // Corner order: top-left, top-right, bottom-left, bottom-right;
+            // (sx, sy) points from E towards that corner.
+            static const int sx[4] = { -1, 1, -1, 1 };
+            static const int sy[4] = { -1, -1, 1, 1 };
+            for (int c = 0; c < 4; ++c) {
+                const int u = sx[c], v = sy[c];
+                // Rotated names as in the bottom-right reference kernel
+                uint8_t F = P(u, 0), H = P(0, v), I = P(u, v);
+                uint8_t C = P(u, -v), G = P(-u, v);
+                uint8_t F4 = P(2 * u, 0), H5 = P(0, 2 * v);
+                uint8_t I4 = P(2 * u, v), I5 = P(u, 2 * v);
+                uint8_t C4 = P(2 * u, -v), G5 = P(-u, 2 * v);
+
+                int wd1 = dist(E, C) + dist(E, G) + dist(I, F4) + dist(I, H5) + 4 * dist(H, F);
+                int wd2 = dist(H, G5) + dist(H, I5) + dist(F, I4) + dist(F, C4) + 4 * dist(E, I);
+
+                uint8_t px = E;
+                if (wd1 < wd2 && E != F && E != H)
+                    px = dist(E, F) <= dist(E, H) ? F : H;
+                out[c] = px;
+            }
+            d0[x * 2] = out[0]; d0[x * 2 + 1] = out[1];
+            d1[x * 2] = out[2]; d1[x * 2 + 1] = out[3];
+        }
+    }
+}
+
+} // namespace
+
+
+const char* scaleFilterName(ScaleFilter filter)
+{
+    switch (filter) {
+    case ScaleFilter::None:      return "none";
+    case ScaleFilter::Nearest2x: return "nearest 2x";
+    case ScaleFilter::Nearest3x: return "nearest 3x";
+    case ScaleFilter::Nearest4x: return "nearest 4x";
+    case ScaleFilter::Scale2x:   return "Scale2x";
+    case ScaleFilter::Scale3x:   return "Scale3x";
+    case ScaleFilter::Scale4x:   return "Scale4x";
+    case ScaleFilter::XBR2x:     return "xBR 2x";
+    default:                     return "?";
+    }
+}
+
+int scaleFactor(ScaleFilter filter)
+{
+    switch (filter) {
+    case ScaleFilter::Nearest2x: case ScaleFilter::Scale2x: case ScaleFilter::XBR2x: return 2;
+    case ScaleFilter::Nearest3x: case ScaleFilter::Scale3x: return 3;
+    case ScaleFilter::Nearest4x: case ScaleFilter::Scale4x: return 4;
+    default: return 1;
+    }
+}
+
+Scaler::Scaler(unsigned threads) : pool(threads) {}
+
+// Split `rows` source rows into one band per pool thread.
+void Scaler::runBands(int rows, const std::function<void(int, int)>& band)
+{
+    const int n = int(pool.size());
+    pool.run(n, [&](int i) {
+        int y0 = rows * i / n, y1 = rows * (i + 1) / n;
+        if (y0 < y1) band(y0, y1);
+    });
+}
+
+void Scaler::scale(const uint8_t src[144][160], uint32_t* out, int pitch)
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    const int k = factor();
+    const int dstW = SRC_W * k;
+    scaled.resize(size_t(dstW) * SRC_H * k);
+    uint8_t* dst = scaled.data();
+
+    // Each band scales its source rows and converts its own output rows
+    auto convert = [&](int y0, int y1) {
+        for (int y = y0 * k; y < y1 * k; ++y)
+            convertToARGB8888(dst + size_t(y) * dstW, out + size_t(y) * pitch, dstW);
+    };
+
+    switch (current) {
+    case ScaleFilter::Nearest2x: case ScaleFilter::Nearest3x: case ScaleFilter::Nearest4x:
+        runBands(SRC_H, [&](int y0, int y1) { nearestRows(&src[0][0], SRC_W, k, dst, y0, y1); convert(y0, y1); });
+        break;
+
+    case ScaleFilter::Scale2x: {
+        int p = padImage(&src[0][0], SRC_W, SRC_H, SRC_W, 1, padded);
+        const uint8_t* s = padded.data() + p + 1;
+        runBands(SRC_H, [&](int y0, int y1) { scale2xRows(s, p, SRC_W, dst, y0, y1); convert(y0, y1); });
+        break;
+    }
+
+    case ScaleFilter::Scale3x: {
+        int p = padImage(&src[0][0], SRC_W, SRC_H, SRC_W, 1, padded);
+        const uint8_t* s = padded.data() + p + 1;
+        runBands(SRC_H, [&](int y0, int y1) { scale3xRows(s, p, dst, y0, y1); convert(y0, y1); });
+        break;
+    }
+
+    case ScaleFilter::Scale4x: {
+        // Two Scale2x passes; the second needs all of the first's rows
+        std::vector<uint8_t>& mid = stage;
+        mid.resize(size_t(SRC_W * 2) * SRC_H * 2);
+        int p = padImage(&src[0][0], SRC_W, SRC_H, SRC_W, 1, padded);
+        const uint8_t* s = padded.data() + p + 1;
+        runBands(SRC_H, [&](int y0, int y1) { scale2xRows(s, p, SRC_W, mid.data(), y0, y1); });
+
+        int p2 = padImage(mid.data(), SRC_W * 2, SRC_H * 2, SRC_W * 2, 1, stagePadded);
+        const uint8_t* s2 = stagePadded.data() + p2 + 1;
+        runBands(SRC_H * 2, [&](int y0, int y1) {
+            scale2xRows(s2, p2, SRC_W * 2, dst, y0, y1);
+            for (int y = y0 * 2; y < y1 * 2; ++y)
+                convertToARGB8888(dst + size_t(y) * dstW, out + size_t(y) * pitch, dstW);
+        });
+        break;
+    }
+
+    case ScaleFilter::XBR2x: {
+        int p = padImage(&src[0][0], SRC_W, SRC_H, SRC_W, 2, padded);
+        const uint8_t* s = padded.data() + 2 * p + 2;
+        runBands(SRC_H, [&](int y0, int y1) { xbr2xRows(s, p, dst, y0, y1); convert(y0, y1); });
+        break;
+    }
+
+    default:
+        runBands(SRC_H, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) convertToARGB8888(src[y], out + size_t(y) * pitch, SRC_W);
+        });
+        break;
+    }
+
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    avgCost = avgCost == 0.0 ? lastCost : avgCost * 0.95 + lastCost * 0.05;
+}
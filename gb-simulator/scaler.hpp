@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "workerpool.hpp"
+
+// CPU-side pixel-art upscaling of a 160x144 shade frame into ARGB, for
+// hosts without a GPU. The filters work on shade indices (one byte per
+// pixel, so 16 pixels per SSE2 register) and convert to ARGB at the end;
+// the frame is split into row bands across a worker pool.
+enum class ScaleFilter {
+    None,        // 1x, let SDL stretch
+    Nearest2x,
+    Nearest3x,
+    Nearest4x,
+    Scale2x,     // AdvMAME2x / EPX
+    Scale3x,     // AdvMAME3x
+    Scale4x,     // Scale2x applied twice
+    XBR2x,       // xBR-style edge-direction 2x, picking palette shades
+    Count
+};
+
+const char* scaleFilterName(ScaleFilter filter);
+int scaleFactor(ScaleFilter filter);
+
+class Scaler {
+public:
+    explicit Scaler(unsigned threads = std::thread::hardware_concurrency());
+
+    void setFilter(ScaleFilter f) { current = f; }
+    ScaleFilter filter() const { return current; }
+    int factor() const { return scaleFactor(current); }
+
+    // Scale `src` into `out` ((160 * factor) x (144 * factor) ARGB pixels,
+    // `pitch` pixels per row).
+    void scale(const uint8_t src[144][160], uint32_t* out, int pitch);
+
+    // Wall-clock cost of the last scale() and a running average, in ms.
+    double lastMs() const { return lastCost; }
+    double averageMs() const { return avgCost; }
+
+private:
+    ScaleFilter current = ScaleFilter::None;
+    WorkerPool pool;
+
+    // Shade images with a 1-pixel replicated border (2 for xBR) so the
+    // kernels never branch on edges, plus the scaled shade image.
+    std::vector<uint8_t> padded;
+    std::vector<uint8_t> stage;      // Scale4x intermediate (320x288)
+    std::vector<uint8_t> stagePadded;
+    std::vector<uint8_t> scaled;
+
+    double lastCost = 0.0;
+    double avgCost = 0.0;
+
+    void runBands(int rows, const std::function<void(int, int)>& band);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+
+// Things that happen a known number of M-cycles after they are set up. Each
+// kind has one slot, so (re)scheduling replaces the pending one.
+enum class SchedEvent : uint8_t {
+    DmaDone,        // OAM DMA finished: copy the 160 bytes
+    SerialDone,     // internal-clock serial transfer shifted all 8 bits
+    SerialPoll,     // look for bytes arriving over the link cable
+    InputDue,       // the next stamped button change (Input queue)
+    AudioBlock,     // hand a block of samples to the APU's output
+    Count
+};
+
+// Event scheduler on the M-cycle clock. Memory owns it and advances it by
+// the length of each instruction; due events come out of popDue() in time
+// order and Memory dispatches them. Nothing is polled per cycle: advance()
+// is one compare while nothing is due.
+class Scheduler {
+public:
+    Scheduler()
+    {
+        for (uint64_t& d : due) d = NEVER;
+    }
+
+    uint64_t now() const { return time; }
+
+    // Replaces a pending event of the same kind, whether earlier or later.
+    void schedule(SchedEvent ev, uint64_t delay)
+    {
+        const bool wasPending = due[int(ev)] != NEVER;
+        due[int(ev)] = time + delay;
+        if (wasPending) recomputeNext();           // it may have been the earliest
+        else if (due[int(ev)] < nextDue) nextDue = due[int(ev)];
+    }
+
+    void cancel(SchedEvent ev)
+    {
+        due[int(ev)] = NEVER;
+        recomputeNext();
+    }
+
+    bool pending(SchedEvent ev) const { return due[int(ev)] != NEVER; }
+    uint64_t when(SchedEvent ev) const { return due[int(ev)]; }
+
+    void advance(uint32_t cycles) { time += cycles; }
+    bool anyDue() const { return time >= nextDue; }
+
+    // Earliest event that is due, removed from the schedule.
+    bool popDue(SchedEvent& ev)
+    {
+        if (time < nextDue) return false;
+        int first = 0;
+        for (int i = 1; i < int(SchedEvent::Count); ++i)
+            if (due[i] < due[first]) first = i;
+        if (due[first] > time) return false;
+        ev = SchedEvent(first);
+        due[first] = NEVER;
+        recomputeNext();
+        return true;
+    }
+
+private:
+    static constexpr uint64_t NEVER = ~uint64_t(0);
+
+    uint64_t time = 0;
+    uint64_t due[int(SchedEvent::Count)];
+    uint64_t nextDue = NEVER;
+
+    void recomputeNext()
+    {
+        nextDue = NEVER;
+        for (uint64_t d : due)
+            if (d < nextDue) nextDue = d;
+    }
+};
@@ -0,0 +1,238 @@
+#include "serial.hpp"
+
+#include "memory.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+
+std::string SerialRingSink::contents() const
+{
+    const size_t n = size_t(std::min<uint64_t>(written, ring.size()));
+    const size_t start = size_t((written - n) % ring.size());
+    std::string out;
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        out.push_back(char(ring[(start + i) % ring.size()]));
+    return out;
+}
+
+bool SerialRingSink::endsWith(const std::string& text) const
+{
+    const std::string all = contents();
+    return all.size() >= text.size()
+        && all.compare(all.size() - text.size(), text.size(), text) == 0;
+}
+
+
+SerialFileSink::SerialFileSink(FILE* file) : out(file)
+{
+    start();
+}
+
+SerialFileSink::SerialFileSink(const std::string& path)
+    : out(std::fopen(path.c_str(), "wb")), ownsFile(true)
+{
+    if (out) start();
+}
+
+SerialFileSink::~SerialFileSink()
+{
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+    if (out && ownsFile) std::fclose(out);
+}
+
+void SerialFileSink::start()
+{
+    pending.reserve(FLUSH_AT);
+    writer = std::thread([this] { writerLoop(); });
+}
+
+void SerialFileSink::put(uint8_t byte)
+{
+    if (!out) return;
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(byte);
+        full = pending.size() >= FLUSH_AT;
+    }
+    if (full) wake.notify_one();
+}
+
+void SerialFileSink::flush()
+{
+    if (!out) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    flushRequested = true;
+    wake.notify_one();
+    drained.wait(lock, [&] { return pending.empty() && !writing; });
+}
+
+void SerialFileSink::writerLoop()
+{
+    std::vector<uint8_t> batch;
+    batch.reserve(FLUSH_AT);
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        // Text usually arrives a line at a time; 50 ms keeps it readable live
+        wake.wait_for(lock, std::chrono::milliseconds(50), [&] {
+            return quitting || flushRequested || pending.size() >= FLUSH_AT;
+        });
+        flushRequested = false;
+        batch.swap(pending);
+        const bool last = quitting;
+        writing = true;
+
+        lock.unlock();
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), out);
+            std::fflush(out);
+            batch.clear();
+        }
+        lock.lock();
+        writing = false;
+        if (pending.empty()) drained.notify_all();
+
+        if (last && pending.empty()) return;
+    }
+}
+
+
+void SerialPort::connect(LinkCable::End* end, Memory* mem)
+{
+    if (link) link->attach(false);
+    link = end;
+    repliesOwed = 0;
+    repliesLost = 0;
+    holding = false;
+    if (!link) {
+        if (memory) memory->scheduler.cancel(SchedEvent::SerialPoll);
+        return;
+    }
+    memory = mem;
+    LinkMessage stale;
+    while (link->receive(stale)) {}
+    link->attach(true);
+    memory->scheduler.schedule(SchedEvent::SerialPoll, POLL_CYCLES);
+}
+
+void SerialPort::writeControl(uint8_t value, Memory* mem)
+{
+    memory = mem;
+    mem->io_registers[0x02] = value | 0x7E;       // bits 1-6 read as 1
+    if ((value & 0x81) != 0x81) {
+        // Clearing bit 7 abandons an internal transfer; an external one
+        // just sits there until the peer clocks it.
+        if (!(value & 0x80)) mem->scheduler.cancel(SchedEvent::SerialDone);
+        return;
+    }
+
+    const uint8_t out = mem->io_registers[0x01];
+    mem->serialOut(out);
+    received = 0xFF;
+    if (link && link->peerAttached() && link->send({ LinkMessage::Data, out }))
+        ++repliesOwed;
+    mem->scheduler.schedule(SchedEvent::SerialDone, TRANSFER_CYCLES);   // a restart replaces it
+}
+
+void SerialPort::complete()
+{
+    // The one place an instance waits for the other: it sent its byte
+    // TRANSFER_CYCLES ago, so the answer is usually here already. Data
+    // from a peer that is clocking at the same time gets refused, or both
+    // would wait forever. A peer that goes quiet for STALL_MS is treated as
+    // unplugged, so a stuck instance cannot hang this one too.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(STALL_MS);
+    while (repliesOwed > 0) {
+        LinkMessage m;
+        if (link->receive(m)) {
+            handle(m);
+            if (holding) answer(true);
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(STALL_MS);
+        }
+        else if (!link->peerAttached() || std::chrono::steady_clock::now() >= deadline) {
+            repliesLost += repliesOwed;
+            repliesOwed = 0;
+            received = 0xFF;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    finish(received);
+}
+
+void SerialPort::pollStopped()
+{
+    // STOP halts the scheduler, so SerialPoll never fires and a held byte
+    // never times out: answer each one at once instead, shifting it in if
+    // SC is armed, so the clocking peer is never left waiting.
+    if (!link) return;
+    LinkMessage m;
+    while (link->receive(m)) {
+        handle(m);
+        if (holding) answer(true);
+    }
+}
+
+void SerialPort::poll()
+{
+    if (!link) return;
+    LinkMessage m;
+    while (!holding && link->receive(m))
+        handle(m);
+    if (holding) answer(false);
+    memory->scheduler.schedule(SchedEvent::SerialPoll, POLL_CYCLES);
+}
+
+void SerialPort::handle(const LinkMessage& m)
+{
+    if (m.kind == LinkMessage::Reply) {
+        if (repliesLost > 0) {       // answer to a transfer given up on
+            --repliesLost;
+            return;
+        }
+        if (repliesOwed > 0) --repliesOwed;
+        received = m.value;
+        return;
+    }
+    if (holding) answer(true);       // the peer restarted its transfer
+    holding = true;
+    held = m.value;
+    heldSince = memory->scheduler.now();
+}
+
+void SerialPort::answer(bool force)
+{
+    // Only a port waiting on the external clock shifts; to anything else
+    // the peer sees an unplugged cable.
+    const bool armed = (memory->io_registers[0x02] & 0x81) == 0x80;
+    if (armed) {
+        const uint8_t out = memory->io_registers[0x01];
+        link->send({ LinkMessage::Reply, out });
+        memory->serialOut(out);
+        finish(held);
+    }
+    else if (force || memory->scheduler.now() - heldSince >= TRANSFER_CYCLES) {
+        link->send({ LinkMessage::Reply, 0xFF });
+    }
+    else {
+        return;
+    }
+    holding = false;
+}
+
+void SerialPort::finish(uint8_t in)
+{
+    memory->io_registers[0x01] = in;
+    memory->io_registers[0x02] &= 0x7F;
+    memory->requestInterrupt(Memory::INT_SERIAL);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "link.hpp"
+
+class Memory;
+
+// Where bytes shifted out through SB end up. put() is called on the
+// emulation thread for every byte and must not do I/O itself.
+class SerialSink {
+public:
+    virtual ~SerialSink() = default;
+    virtual void put(uint8_t byte) = 0;
+    virtual void flush() {}
+};
+
+// Default sink: the last `capacity` bytes in memory, plus a running count.
+// Test harnesses match against it directly (e.g. blargg's "Passed").
+class SerialRingSink : public SerialSink {
+public:
+    explicit SerialRingSink(size_t capacity = 64 * 1024) : ring(capacity) {}
+
+    void put(uint8_t byte) override
+    {
+        ring[written % ring.size()] = byte;
+        ++written;
+    }
+
+    std::string contents() const;                       // oldest to newest
+    bool contains(const std::string& text) const { return contents().find(text) != std::string::npos; }
+    bool endsWith(const std::string& text) const;
+    uint64_t total() const { return written; }           // bytes ever written
+    void clear() { written = 0; }
+
+private:
+    std::vector<uint8_t> ring;
+    uint64_t written = 0;
+};
+
+// Streams bytes to stdout or a file from a background thread: put() only
+// appends to a buffer under a mutex, and the writer flushes it when it
+// fills up, after a short idle delay, and on destruction.
+class SerialFileSink : public SerialSink {
+public:
+    explicit SerialFileSink(FILE* out);                 // not closed
+    explicit SerialFileSink(const std::string& path);   // opened and closed here
+    ~SerialFileSink() override;
+
+    SerialFileSink(const SerialFileSink&) = delete;
+    SerialFileSink& operator=(const SerialFileSink&) = delete;
+
+    bool isOpen() const { return out != nullptr; }
+    void put(uint8_t byte) override;
+    void flush() override;   // returns once everything put so far is written
+
+private:
+    static constexpr size_t FLUSH_AT = 4096;
+
+    FILE* out = nullptr;
+    bool ownsFile = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::vector<uint8_t> pending;
+    bool flushRequested = false;
+    bool writing = false;
+    bool quitting = false;
+    std::thread writer;
+
+    void start();
+    void writerLoop();
+};
+
+
+// The SB/SC serial port. A transfer on the internal clock (SC = 0x81)
+// takes 8 bits at 8192 Hz and completes through the scheduler; on the
+// external clock (SC = 0x80) it waits for the other Game Boy's clock. With
+// no cable, or nobody answering, the byte shifted in is 0xFF.
+//
+// Over a LinkCable the clocking side sends its byte when the transfer
+// starts and only waits for the reply when its own transfer ends, so two
+// instances running freely on separate threads rarely block each other.
+// The other side looks for incoming bytes every POLL_CYCLES, and gives its
+// program up to a transfer's length to arm SC before answering 0xFF, which
+// absorbs the drift between the two clocks.
+class SerialPort {
+public:
+    static constexpr int CYCLES_PER_BIT = 128;                 // M-cycles at 8192 Hz
+    static constexpr int TRANSFER_CYCLES = 8 * CYCLES_PER_BIT;
+    static constexpr int POLL_CYCLES = CYCLES_PER_BIT;
+    static constexpr int STALL_MS = 1000;     // wall time before a silent peer counts as gone
+
+    ~SerialPort() { connect(nullptr, nullptr); }
+
+    void connect(LinkCable::End* end, Memory* mem);   // nullptr unplugs
+    bool connected() const { return link != nullptr; }
+
+    void writeControl(uint8_t value, Memory* mem);    // SC write
+    void complete();                                  // SchedEvent::SerialDone
+    void poll();                                      // SchedEvent::SerialPoll
+    void pollStopped();                               // each step while STOP holds the clock
+
+private:
+    Memory* memory = nullptr;
+    LinkCable::End* link = nullptr;
+    int repliesOwed = 0;          // Data sent that the peer has not answered
+    int repliesLost = 0;          // ... and that complete() stopped waiting for
+    uint8_t received = 0xFF;      // last reply
+    bool holding = false;         // peer's Data not answered yet
+    uint8_t held = 0;
+    uint64_t heldSince = 0;
+
+    void handle(const LinkMessage& m);
+    void answer(bool force);      // shift the held byte in, or refuse it
+    void finish(uint8_t in);      // SB = in, SC bit 7 off, serial interrupt
+};
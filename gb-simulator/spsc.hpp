@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free single-producer / single-consumer ring. push() is only
+// ever called from one thread and pop() from one other; both return false
+// instead of blocking, so the caller decides how to wait. N must be a
+// power of two.
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    bool push(const T& value)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h - tailCache == N) {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h - tailCache == N) return false;        // full
+        }
+        slots[h & (N - 1)] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == headCache) {
+            headCache = head.load(std::memory_order_acquire);
+            if (t == headCache) return false;            // empty
+        }
+        value = slots[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from either side while the other is running.
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    // Producer and consumer indices on separate cache lines, each with a
+    // cached copy of the other side's index to avoid needless sharing.
+    alignas(64) std::atomic<size_t> head { 0 };
+    size_t tailCache = 0;                 // producer's view of tail
+    alignas(64) std::atomic<size_t> tail { 0 };
+    size_t headCache = 0;                 // consumer's view of head
+    alignas(64) T slots[N];
+};
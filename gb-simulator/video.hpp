@@ -2,7 +2,13 @@
 
 #include <SDL.h>  
 #include <cstring> // Include for std::memcpy  
+#include <cstdio>
+#include <vector>
 #include "input.hpp"
+#include "pixelconv.hpp"
+#include "frame.hpp"
+#include "pacer.hpp"
+#include "scaler.hpp"
 
 
 class Video {  
@@ -11,48 +17,162 @@ public:
         SDL_Init(SDL_INIT_VIDEO);  
         win = SDL_CreateWindow("GB", SDL_WINDOWPOS_CENTERED,  
             SDL_WINDOWPOS_CENTERED, 640, 576, 0);  
-        tex = SDL_CreateTexture(SDL_CreateRenderer(win, -1, 0),  
-            SDL_PIXELFORMAT_ARGB8888,  
-            SDL_TEXTUREACCESS_STREAMING,  
-            160, 144);  
+        SDL_CreateRenderer(win, -1, 0);
+        createTexture();
     }  
-    ~Video() { SDL_Quit(); }  
+    ~Video() {
+        if (audioDevice) SDL_CloseAudioDevice(audioDevice);
+        SDL_Quit();
+    }
 
-    void present(const uint32_t fb[144][160]) {  
-        void* pixels; int pitch;  
-        SDL_LockTexture(tex, nullptr, &pixels, &pitch);  
+    // Stereo 16-bit audio through SDL's queue. queueAudio() may be called
+    // from the emulation thread; past maxQueuedMs of backlog (fast-forward)
+    // blocks are dropped rather than piling up latency.
+    bool openAudio(int sampleRate, int maxQueuedMs = 100) {
+        if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) return false;
+        SDL_AudioSpec want {};
+        want.freq = sampleRate;
+        want.format = AUDIO_S16SYS;
+        want.channels = 2;
+        want.samples = 512;
+        audioDevice = SDL_OpenAudioDevice(nullptr, 0, &want, nullptr, 0);
+        if (!audioDevice) return false;
+        maxQueuedBytes = uint32_t(sampleRate) * 4 * maxQueuedMs / 1000;
+        SDL_PauseAudioDevice(audioDevice, 0);
+        return true;
+    }
+    void queueAudio(const int16_t* samples, int frames) {
+        if (!audioDevice || SDL_GetQueuedAudioSize(audioDevice) > maxQueuedBytes) return;
+        SDL_QueueAudio(audioDevice, samples, uint32_t(frames) * 4);
+    }
 
-        // Fix for potential arithmetic overflow  
-        size_t bufferSize = static_cast<size_t>(144) * 160 * sizeof(uint32_t);  
-        std::memcpy(pixels, fb, bufferSize);  
+    // Upload only the rows that differ from what the texture shows, and skip
+    // the present completely when nothing changed. Right after the frame on
+    // screen, Frame::changedLines is exact; after dropped frames the row
+    // signatures are compared instead. Returns whether it presented.
+    bool present(const Frame& frame) {  
+        if (scaler.filter() != ScaleFilter::None)
+            return presentScaled(frame);
 
-        SDL_UnlockTexture(tex);  
+        const bool consecutive = textureValid && frame.number == shownNumber + 1;
+        auto rowDirty = [&](int y) {
+            if (!textureValid) return true;
+            if (consecutive) return bool(frame.changedLines[y]);
+            return frame.lineSig[y] == 0 || frame.lineSig[y] != shownSig[y];
+        };
 
-        SDL_Renderer* ren = SDL_GetRenderer(win);  
-        SDL_RenderClear(ren);  
-        SDL_RenderCopy(ren, tex, nullptr, nullptr);  
-        SDL_RenderPresent(ren);  
+        bool uploaded = false;
+        if (!(consecutive && frame.identical)) {
+            for (int y = 0; y < 144; ) {
+                if (!rowDirty(y)) { ++y; continue; }
+                int y0 = y;
+                while (y < 144 && rowDirty(y)) ++y;
+
+                // Shades -> ARGB for the run of dirty rows, then one upload
+                convertToARGB8888(frame.pixels[y0], staging + y0 * 160, size_t(y - y0) * 160);
+                SDL_Rect rect{ 0, y0, 160, y - y0 };
+                SDL_UpdateTexture(tex, &rect, staging + y0 * 160, 160 * sizeof(uint32_t));
+                uploaded = true;
+            }
+        }
+        std::memcpy(shownSig, frame.lineSig, sizeof(shownSig));
+        shownNumber = frame.number;
+        textureValid = true;
+
+        if (!uploaded && !redrawNeeded) return false;
+        redrawNeeded = false;
+
+        render();
+        return true;
     }  
-    bool ProcessInput(Input& input) {
+
+    // Present the texture again unchanged. With vsync on this blocks until
+    // the next refresh, which is what paces PacingMode::VsyncLocked.
+    void refresh() { render(); }
+
+    void setVsync(bool on) { SDL_RenderSetVSync(SDL_GetRenderer(win), on ? 1 : 0); }
+
+    // F3 cycles the pacer's mode; vsync follows it.
+    void attachPacer(FramePacer* p) {
+        pacer = p;
+        if (pacer) setVsync(pacer->mode() == PacingMode::VsyncLocked);
+    }
+
+    // Window title: pacing mode, measured rate and jitter, filter cost.
+    void updateTitle() {
+        char title[160];
+        int n = std::snprintf(title, sizeof(title), "GB");
+        if (pacer) {
+            FramePacer::Stats st = pacer->stats();
+            n += std::snprintf(title + n, sizeof(title) - n, " - %s %.2f fps, jitter %.2f ms (max %.2f ms)",
+                pacingModeName(pacer->mode()), st.fps, st.jitterMs, st.maxMs);
+        }
+        if (scaler.filter() != ScaleFilter::None && n < int(sizeof(title))) {
+            std::snprintf(title + n, sizeof(title) - n, " - %s %.2f ms (avg %.2f ms)",
+                scaleFilterName(scaler.filter()), scaler.lastMs(), scaler.averageMs());
+        }
+        SDL_SetWindowTitle(win, title);
+    }
+
+    // Host-side upscaling (see scaler.hpp); F2 cycles through the filters.
+    void setScaleFilter(ScaleFilter filter) {
+        if (filter == scaler.filter()) return;
+        scaler.setFilter(filter);
+        createTexture();
+        updateTitle();
+    }
+    ScaleFilter scaleFilter() const { return scaler.filter(); }
+    // Drain the SDL event queue. Button changes are queued with their SDL
+    // timestamp rather than applied, see HostInputQueue. Returns false when
+    // the window was closed.
+    bool ProcessInput(HostInputQueue& queue) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
-
-            bool pressed = (event.type == SDL_KEYDOWN);
-            if (event.window.event == SDL_WINDOWEVENT_CLOSE) {
+            switch (event.type) {
+            case SDL_QUIT:
                 return false;
+
+            case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_CLOSE)
+                    return false;
+                if (event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                    redrawNeeded = true;   // window content lost, present even if unchanged
+                break;
+
+            case SDL_KEYDOWN:
+            case SDL_KEYUP: {
+                if (event.key.repeat) break;       // held key, nothing changed
+                bool pressed = (event.type == SDL_KEYDOWN);
+                uint32_t t = event.key.timestamp;
+                switch (event.key.keysym.sym) {
+                    // Direction keys
+                case SDLK_RIGHT: queue.push(t, GbButton::Right, pressed); break;
+                case SDLK_LEFT:  queue.push(t, GbButton::Left, pressed); break;
+                case SDLK_UP:    queue.push(t, GbButton::Up, pressed); break;
+                case SDLK_DOWN:  queue.push(t, GbButton::Down, pressed); break;
+
+                    // Action buttons
+                case SDLK_TAB:       queue.push(t, GbButton::A, pressed); break;
+                case SDLK_BACKSPACE: queue.push(t, GbButton::B, pressed); break;
+                case SDLK_ESCAPE:    queue.push(t, GbButton::Select, pressed); break;
+                case SDLK_RETURN:    queue.push(t, GbButton::Start, pressed); break;
+
+                case SDLK_F2:
+                    if (pressed)
+                        setScaleFilter(ScaleFilter((int(scaler.filter()) + 1) % int(ScaleFilter::Count)));
+                    break;
+
+                case SDLK_F3:
+                    if (pressed && pacer) {
+                        PacingMode next = PacingMode((int(pacer->mode()) + 1) % int(PacingMode::Count));
+                        pacer->setMode(next);
+                        setVsync(next == PacingMode::VsyncLocked);
+                        updateTitle();
+                    }
+                    break;
+                }
+                break;
             }
-            switch (event.key.keysym.sym) {
-                // Direction keys
-            case SDLK_RIGHT: input.set_button(GbButton::Right, pressed); break;
-            case SDLK_LEFT:  input.set_button(GbButton::Left, pressed); break;
-            case SDLK_UP:    input.set_button(GbButton::Up, pressed); break;
-            case SDLK_DOWN:  input.set_button(GbButton::Down, pressed); break;
-
-                // Action buttons
-            case SDLK_TAB:     input.set_button(GbButton::A, pressed); break;
-            case SDLK_BACKSPACE:     input.set_button(GbButton::B, pressed); break;
-            case SDLK_ESCAPE:        input.set_button(GbButton::Select, pressed); break;
-            case SDLK_RETURN:   input.set_button(GbButton::Start, pressed); break;
             }
         }
 
@@ -61,4 +181,65 @@ public:
 private:  
     SDL_Window* win = nullptr;  
     SDL_Texture* tex = nullptr;  
+    SDL_AudioDeviceID audioDevice = 0;
+    uint32_t maxQueuedBytes = 0;
+
+    Scaler scaler;
+    std::vector<uint32_t> scaledPixels;
+    FramePacer* pacer = nullptr;
+
+    // The texture is 160x144 times the filter's factor; SDL stretches the
+    // rest of the way to the window.
+    void createTexture() {
+        if (tex) SDL_DestroyTexture(tex);
+        const int k = scaler.factor();
+        tex = SDL_CreateTexture(SDL_GetRenderer(win),
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            160 * k, 144 * k);
+        scaledPixels.assign(size_t(160 * k) * 144 * k, 0);
+        textureValid = false;
+        redrawNeeded = true;
+    }
+
+    // Filters look at neighbouring rows, so any change re-scales the whole
+    // frame; unchanged frames still skip the work and the present.
+    bool presentScaled(const Frame& frame) {
+        const bool consecutive = textureValid && frame.number == shownNumber + 1;
+        // Same rule as present(): a zero signature (mid-line writes) is never
+        // known to match, so it counts as a change.
+        auto sigsMatch = [&] {
+            for (int y = 0; y < 144; ++y)
+                if (frame.lineSig[y] == 0 || frame.lineSig[y] != shownSig[y]) return false;
+            return true;
+        };
+        const bool unchanged = textureValid && (consecutive ? frame.identical : sigsMatch());
+        std::memcpy(shownSig, frame.lineSig, sizeof(shownSig));
+        shownNumber = frame.number;
+
+        if (unchanged && !redrawNeeded) return false;
+        if (!unchanged || !textureValid) {
+            const int k = scaler.factor();
+            scaler.scale(frame.pixels, scaledPixels.data(), 160 * k);
+            SDL_UpdateTexture(tex, nullptr, scaledPixels.data(), 160 * k * sizeof(uint32_t));
+            textureValid = true;
+        }
+        redrawNeeded = false;
+        render();
+        return true;
+    }
+
+    void render() {
+        SDL_Renderer* ren = SDL_GetRenderer(win);
+        SDL_RenderClear(ren);
+        SDL_RenderCopy(ren, tex, nullptr, nullptr);
+        SDL_RenderPresent(ren);
+    }
+
+    // What the texture currently shows, for partial uploads
+    uint32_t staging[144 * 160] {};
+    uint64_t shownSig[144] {};
+    uint64_t shownNumber = 0;
+    bool textureValid = false;
+    bool redrawNeeded = true;
 };
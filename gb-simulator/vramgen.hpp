@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Per-region write generations for VRAM. Every write that changes a byte
+// bumps the counter of the tile (0x8000-0x97FF) or tile-map entry
+// (0x9800-0x9FFF) it lands in, so caches can tell exactly what went stale.
+struct VRAMGenerations {
+    uint32_t tile[384] {};          // 16-byte tiles, index = offset / 16
+    uint32_t mapCell[2][1024] {};   // [0] = 0x9800 map, [1] = 0x9C00 map
+    uint32_t total = 0;             // any change at all
+
+    void touch(uint16_t offset)     // offset from 0x8000
+    {
+        ++total;
+        if (offset < 0x1800)
+            ++tile[offset >> 4];
+        else
+            ++mapCell[(offset - 0x1800) >> 10][offset & 0x3FF];
+    }
+};
@@ -0,0 +1,67 @@
+#include "workerpool.hpp"
+
+
+WorkerPool::WorkerPool(unsigned threads)
+{
+    if (threads == 0) threads = 1;
+    for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void WorkerPool::run(int tasks, const std::function<void(int)>& fn)
+{
+    if (workers.empty() || tasks <= 1) {
+        for (int i = 0; i < tasks; ++i) fn(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        taskCount = tasks;
+        nextTask.store(0, std::memory_order_relaxed);
+        busy = int(workers.size());
+        ++batch;
+    }
+    wake.notify_all();
+
+    drain();                      // the caller works too
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::drain()
+{
+    for (int i = nextTask.fetch_add(1); i < taskCount; i = nextTask.fetch_add(1))
+        (*job)(i);
+}
+
+void WorkerPool::workerLoop()
+{
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quitting || batch != seen; });
+            if (quitting) return;
+            seen = batch;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0) finished.notify_one();
+    }
+}
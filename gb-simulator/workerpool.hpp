@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fork/join pool: run(n, fn) calls fn(0) .. fn(n-1) spread over the
+// worker threads and the calling thread, and returns once all are done.
+// Meant for splitting one frame's work into bands, so jobs are expected to
+// be similar in size and there is no queue beyond the current batch.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads = std::thread::hardware_concurrency());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void run(int tasks, const std::function<void(int)>& fn);
+    unsigned size() const { return unsigned(workers.size()) + 1; }  // incl. caller
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    const std::function<void(int)>* job = nullptr;
+    int taskCount = 0;
+    std::atomic<int> nextTask { 0 };
+    int busy = 0;                 // workers still inside the current batch
+    uint64_t batch = 0;           // bumped for every run()
+    bool quitting = false;
+
+    void workerLoop();
+    void drain();
+};